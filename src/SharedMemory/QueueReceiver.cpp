@@ -18,21 +18,76 @@
 #include <monitoring/HltStatistics.h>
 
 #include <l1/L1TriggerProcessor.h>
+#include <options/Logging.h>
+
+#include <algorithm>
+#include <sstream>
+
+#include "../options/MyOptions.h"
 
 namespace na62 {
 
-uint QueueReceiver::highest_burst_id_received_;
+SharedMemoryRing<TriggerMessager>* QueueReceiver::responseRing_ = nullptr;
+std::atomic<uint64_t> QueueReceiver::parks_(0);
+std::mutex QueueReceiver::statisticsMutex_;
 
-QueueReceiver::QueueReceiver() {
+static const std::string RESPONSE_RING_NAME = "/na62-trigger-responses";
+
+QueueReceiver::QueueReceiver(uint receiverID) {
 	running_ = true;
+	receiverID_ = receiverID;
 	highest_burst_id_received_ = 0;
+	event_received_per_burst_ = 0;
+	events_in_ = 0;
+	events_l1_requested_ = 0;
 }
 
 QueueReceiver::~QueueReceiver() {
 }
 
+void QueueReceiver::initialize() {
+	if (!MyOptions::GetBool(OPTION_TRIGGER_RESPONSE_RING)) {
+		return;
+	}
+	const uint numberOfReceivers = std::max(MyOptions::GetInt(OPTION_TRIGGER_RESPONSE_RECEIVERS), 1);
+	responseRing_ = SharedMemoryRing<TriggerMessager>::create(RESPONSE_RING_NAME, numberOfReceivers,
+			MyOptions::GetInt(OPTION_TRIGGER_RESPONSE_RING_SIZE));
+	LOG_INFO("Receiving the L1 trigger responses from " << RESPONSE_RING_NAME << " with " << numberOfReceivers << " QueueReceivers");
+}
+
+void QueueReceiver::shutDown() {
+	if (responseRing_ != nullptr) {
+		SharedMemoryRing<TriggerMessager>::remove(RESPONSE_RING_NAME);
+	}
+}
+
+std::string QueueReceiver::serializeResponseRingSizes() {
+	std::stringstream stream;
+	for (uint i = 0; i != getNumberOfReceivers(); i++) {
+		stream << i << "," << (responseRing_ == nullptr ? 0 : responseRing_->getSize(i)) << ";";
+	}
+	return stream.str();
+}
+
+uint64_t QueueReceiver::getNumberOfQueuedResponses() {
+	uint64_t sum = 0;
+	if (responseRing_ != nullptr) {
+		for (uint i = 0; i != responseRing_->getNumberOfShards(); i++) {
+			sum += responseRing_->getSize(i);
+		}
+	}
+	return sum;
+}
+
 void QueueReceiver::thread() {
-	uint event_received_per_burst = 0;
+	if (responseRing_ != nullptr) {
+		receiveFromRing();
+	} else {
+		receiveFromQueue();
+	}
+}
+
+void QueueReceiver::receiveFromQueue() {
 	while (running_) {
 		TriggerMessager trigger_message;
 		uint priority = 0;
@@ -40,74 +95,122 @@ void QueueReceiver::thread() {
 		//Receiving Response
 		if (SharedMemoryManager::popTriggerResponseQueue(trigger_message, priority)) {
 			//LOG_INFO("Queue Receiver Received trigger response of event: "<<trigger_message.event_id);
+			handleTriggerResponse(trigger_message);
+			publishStatistics();
+		} /*else {
+		 boost::this_thread::sleep(boost::posix_time::microsec(50));
+		 }*/
 
-			if (trigger_message.burst_id != BurstIdHandler::getCurrentBurstId()) {
-				LOG_ERROR("Receiving data belonging to burst id: " << trigger_message.burst_id<<" Skipping...");
-				continue;
-			}
+		//usleep(1000000);
+	}
+}
 
-			//Handling counters for L1 event processed
-			if (highest_burst_id_received_ < trigger_message.burst_id) {
-				LOG_INFO("########################Received from burst "<< highest_burst_id_received_ << " : " << event_received_per_burst);
-				SharedMemoryManager::showLastBurst(20);
+void QueueReceiver::receiveFromRing() {
+	const uint spins = MyOptions::GetInt(OPTION_TP_IDLE_SPINS);
+	const uint parkTimeoutMicros = MyOptions::GetInt(OPTION_IDLE_PARK_TIMEOUT);
+
+	TriggerMessager trigger_messages[RECEIVE_BATCH_SIZE];
+	uint unsuccessfulPolls = 0;
+	while (running_) {
+		const uint received = responseRing_->pop(receiverID_, trigger_messages, RECEIVE_BATCH_SIZE);
+		for (uint i = 0; i != received; i++) {
+			handleTriggerResponse(trigger_messages[i]);
+		}
+		publishStatistics();
+
+		if (received != 0) {
+			unsuccessfulPolls = 0;
+		} else if (unsuccessfulPolls++ < spins) {
+#if defined(__x86_64__) || defined(__i386__)
+			__builtin_ia32_pause();
+#endif
+		} else {
+			/*
+			 * The timeout makes sure a stop is noticed
+			 */
+			parks_.fetch_add(1, std::memory_order_relaxed);
+			responseRing_->park(receiverID_, parkTimeoutMicros);
+		}
+	}
+}
+
+void QueueReceiver::handleTriggerResponse(TriggerMessager& trigger_message) {
+	if (trigger_message.burst_id != BurstIdHandler::getCurrentBurstId()) {
+		LOG_ERROR("Receiving data belonging to burst id: " << trigger_message.burst_id<<" Skipping...");
+		return;
+	}
+
+	//Handling counters for L1 event processed
+	if (highest_burst_id_received_ < trigger_message.burst_id) {
+		LOG_INFO("########################Received from burst "<< highest_burst_id_received_ << " : " << event_received_per_burst_);
+		publishStatistics();
+		if (receiverID_ == 0) {
+			std::lock_guard<std::mutex> lock(statisticsMutex_);
+			SharedMemoryManager::showLastBurst(20);
+		}
+
+		highest_burst_id_received_ = trigger_message.burst_id;
+		event_received_per_burst_ = 0;
+	}
+	event_received_per_burst_++;
+
+	//Counting event arrived in time
+	events_in_++;
+
+	if (trigger_message.level == 1) {
+
+		//printf("l0 trigger flags %d \n", trigger_message.l1_trigger_type_word);
+
+		//Fetching the l0 word
+		Event* event = EventPool::getEvent(trigger_message.event_id);
+		uint_fast8_t l0TriggerTypeWord = event->getL0TriggerTypeWord();
+
+		uint_fast16_t L0L1Trigger(l0TriggerTypeWord | trigger_message.l1_trigger_type_word << 8);
+
+		event->setRrequestZeroSuppressedCreamData(trigger_message.isRequestZeroSuppressed);
+		event->setL1TriggerWords(trigger_message.l1TriggerWords);
+		//Writing L0 info
+		L1TriggerProcessor::writeL1Data(event, &trigger_message.l1Info, trigger_message.isL1WhileTimeout);
+		event->setL1Processed(L0L1Trigger);
+
+		/*STATISTICS*/
+		HltStatistics::updateL1Statistics(event, trigger_message.l1_trigger_type_word);
+
+		if (trigger_message.l1_trigger_type_word != 0) {
+			if (SourceIDManager::NUMBER_OF_EXPECTED_L1_PACKETS_PER_EVENT != 0) {
+				//LOG_ERROR("Sending L1 Request for: " << event->getEventNumber() <<" !");
+				L1Builder::sendL1Request(event);
+				event->setL1Requested();
+				events_l1_requested_++;
 
-				highest_burst_id_received_ = trigger_message.burst_id;
-				event_received_per_burst = 0;
-			}
-			event_received_per_burst++;
-
-			//Counting event arrived in time
-			uint amount = 1;
-			SharedMemoryManager::setEventIn(trigger_message.burst_id, amount);
-
-			if (trigger_message.level == 1) {
-
-				//printf("l0 trigger flags %d \n", trigger_message.l1_trigger_type_word);
-
-				//Fetching the l0 word
-				Event* event = EventPool::getEvent(trigger_message.event_id);
-				uint_fast8_t l0TriggerTypeWord = event->getL0TriggerTypeWord();
-
-				uint_fast16_t L0L1Trigger(l0TriggerTypeWord | trigger_message.l1_trigger_type_word << 8);
-
-				event->setRrequestZeroSuppressedCreamData(trigger_message.isRequestZeroSuppressed);
-				event->setL1TriggerWords(trigger_message.l1TriggerWords);
-				//Writing L0 info
-				L1TriggerProcessor::writeL1Data(event, &trigger_message.l1Info, trigger_message.isL1WhileTimeout);
-				event->setL1Processed(L0L1Trigger);
-
-				/*STATISTICS*/
-				HltStatistics::updateL1Statistics(event, trigger_message.l1_trigger_type_word);
-
-				if (trigger_message.l1_trigger_type_word != 0) {
-					if (SourceIDManager::NUMBER_OF_EXPECTED_L1_PACKETS_PER_EVENT != 0) {
-						//LOG_ERROR("Sending L1 Request for: " << event->getEventNumber() <<" !");
-						L1Builder::sendL1Request(event);
-						event->setL1Requested();
-						SharedMemoryManager::setEventL1Requested(event->getBurstID(), 1);
-
-					} else {
-						L2Builder::processL2(event);
-						//LOG_ERROR("ERROR we should not arrive here!");
-					}
-				} else { // Event not accepted
-					/*
-					 * If the Event has been rejected by L1 we can destroy it now
-					 */
-					//LOG_ERROR("Event: " << event->getEventNumber() <<" discarded from L1");
-					EventPool::freeEvent(event);
-				}
 			} else {
-				LOG_ERROR("Bad Level trigger to execute");
-				continue;
+				L2Builder::processL2(event);
+				//LOG_ERROR("ERROR we should not arrive here!");
 			}
+		} else { // Event not accepted
+			/*
+			 * If the Event has been rejected by L1 we can destroy it now
+			 */
+			//LOG_ERROR("Event: " << event->getEventNumber() <<" discarded from L1");
+			EventPool::freeEvent(event);
+		}
+	} else {
+		LOG_ERROR("Bad Level trigger to execute");
+	}
+}
 
-		} /*else {
-		 boost::this_thread::sleep(boost::posix_time::microsec(50));
-		 }*/
+void QueueReceiver::publishStatistics() {
+	if (events_in_ == 0 && events_l1_requested_ == 0) {
+		return;
+	}
 
-		//usleep(1000000);
+	std::lock_guard<std::mutex> lock(statisticsMutex_);
+	SharedMemoryManager::setEventIn(highest_burst_id_received_, events_in_);
+	if (events_l1_requested_ != 0) {
+		SharedMemoryManager::setEventL1Requested(highest_burst_id_received_, events_l1_requested_);
 	}
+	events_in_ = 0;
+	events_l1_requested_ = 0;
 }
 
 void QueueReceiver::onInterruption() {
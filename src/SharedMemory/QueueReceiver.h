@@ -10,21 +10,93 @@
 
 #include <boost/interprocess/ipc/message_queue.hpp>
 #include <atomic>
+#include <mutex>
+#include <string>
 
 #include "utils/AExecutable.h"
+#include "structs/TriggerMessager.h"
+#include "SharedMemoryRing.h"
 
 namespace na62 {
 
+/*
+ * Receives the L1 decisions of the trigger processes. By default they are popped one by one from
+ * the boost message queue of the SharedMemoryManager. With triggerResponseRing the trigger processes
+ * push them to a SharedMemoryRing instead, with one shard per QueueReceiver selected by event number.
+ */
 class QueueReceiver: public AExecutable {
 public:
-	QueueReceiver();
+	QueueReceiver(uint receiverID = 0);
 	virtual ~QueueReceiver();
 
+	/**
+	 * Creates the response ring if triggerResponseRing is set. Must be called before the trigger processes are started
+	 */
+	static void initialize();
+
+	/**
+	 * Removes the name of the response ring so that the segment is freed once every process has unmapped it
+	 */
+	static void shutDown();
+
+	static inline uint getNumberOfReceivers() {
+		return responseRing_ == nullptr ? 1 : responseRing_->getNumberOfShards();
+	}
+
+	static inline bool isResponseRingEnabled() {
+		return responseRing_ != nullptr;
+	}
+
+	/*
+	 * Format is "receiverID,value;"
+	 */
+	static std::string serializeResponseRingSizes();
+
+	/*
+	 * Number of responses pushed to the ring but not handled yet
+	 */
+	static uint64_t getNumberOfQueuedResponses();
+
+	static uint64_t getNumberOfParks() {
+		return parks_;
+	}
+
 private:
 	virtual void thread() override;
 	virtual void onInterruption() override;
+
+	void receiveFromQueue();
+	void receiveFromRing();
+	void handleTriggerResponse(TriggerMessager& trigger_message);
+
+	/**
+	 * Adds the events counted since the last call to the burst statistics in the shared memory
+	 */
+	void publishStatistics();
+
+	/*
+	 * Responses popped from the ring at once
+	 */
+	static const uint RECEIVE_BATCH_SIZE = 32;
+
+	static SharedMemoryRing<TriggerMessager>* responseRing_;
+	static std::atomic<uint64_t> parks_;
+
+	/*
+	 * The statistics in the shared memory are not meant to be updated by several threads at once
+	 */
+	static std::mutex statisticsMutex_;
+
 	std::atomic<bool> running_;
-	static uint highest_burst_id_received_;
+	uint receiverID_;
+	uint highest_burst_id_received_;
+	uint event_received_per_burst_;
+
+	/*
+	 * Events of burst highest_burst_id_received_ not yet added to the shared memory statistics
+	 */
+	uint events_in_;
+	uint events_l1_requested_;
 
 };
 
@@ -0,0 +1,283 @@
+/*
+ * SharedMemoryRing.h
+ *
+ * Lock-free rings of fixed size records in a POSIX shared memory segment
+ *
+ *  Created on: Oct 18, 2026
+ */
+
+#ifndef SHAREDMEMORYRING_H_
+#define SHAREDMEMORYRING_H_
+
+#include <fcntl.h>
+#include <linux/futex.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <sys/syscall.h>
+#include <sys/types.h>
+#include <unistd.h>
+#include <atomic>
+#include <cstdint>
+#include <ctime>
+#include <new>
+#include <stdexcept>
+#include <string>
+
+namespace na62 {
+
+/*
+ * The segment holds several shards, each one a bounded multi producer single consumer ring: any
+ * number of threads in any number of processes may push, but every shard is popped by one single
+ * thread. Producers choose the shard by event number so that several receivers can share the load.
+ *
+ * Every cell carries a sequence number telling whether it is free or filled for the current round,
+ * so producers only contend on the tail of their shard and the consumer pops without atomic
+ * read-modify-write operations. A consumer finding its shard empty parks on a futex in the segment
+ * which is woken up by the next push.
+ *
+ * Records are copied with their assignment operator and must not contain pointers. The segment is
+ * created by the farm and opened by the trigger processes, which include this header. A producer
+ * dying between reserving and filling a cell blocks its shard until the segment is created again.
+ */
+template<typename Record>
+class SharedMemoryRing {
+public:
+	/**
+	 * Creates the segment <name> with <numberOfShards> rings of at least <capacity> records each.
+	 * An existing segment with the same name is replaced
+	 */
+	static SharedMemoryRing* create(const std::string& name, uint numberOfShards, uint capacity) {
+		uint roundedCapacity = 1;
+		while (roundedCapacity < capacity) {
+			roundedCapacity <<= 1;
+		}
+
+		shm_unlink(name.c_str());
+		int fd = shm_open(name.c_str(), O_CREAT | O_EXCL | O_RDWR, 0666);
+		if (fd < 0) {
+			throw std::runtime_error("Unable to create the shared memory segment " + name);
+		}
+		const size_t size = getSegmentSize(numberOfShards, roundedCapacity);
+		if (ftruncate(fd, size) != 0) {
+			close(fd);
+			throw std::runtime_error("Unable to resize the shared memory segment " + name);
+		}
+
+		SharedMemoryRing* ring = new SharedMemoryRing(map(fd, size, name), size);
+		close(fd);
+
+		Header* header = ring->header_;
+		header->numberOfShards = numberOfShards;
+		header->capacity = roundedCapacity;
+		header->recordSize = sizeof(Record);
+		ring->locateCells();
+		for (uint shardNum = 0; shardNum != numberOfShards; shardNum++) {
+			Shard* shard = new (&ring->shards_[shardNum]) Shard();
+			shard->tail = 0;
+			shard->head = 0;
+			shard->epoch = 0;
+			shard->parked = 0;
+			for (uint i = 0; i != roundedCapacity; i++) {
+				new (&ring->getCell(shardNum, i).sequence) std::atomic<uint64_t>(i);
+			}
+		}
+
+		/*
+		 * Producers only use the segment once the magic number is set
+		 */
+		std::atomic_thread_fence(std::memory_order_release);
+		header->magic = MAGIC;
+		return ring;
+	}
+
+	/**
+	 * Opens the segment <name> created by another process
+	 */
+	static SharedMemoryRing* open(const std::string& name) {
+		int fd = shm_open(name.c_str(), O_RDWR, 0);
+		if (fd < 0) {
+			throw std::runtime_error("Unable to open the shared memory segment " + name);
+		}
+		struct stat status;
+		if (fstat(fd, &status) != 0 || (size_t) status.st_size < sizeof(Header)) {
+			close(fd);
+			throw std::runtime_error("Shared memory segment " + name + " is not initialized");
+		}
+
+		SharedMemoryRing* ring = new SharedMemoryRing(map(fd, status.st_size, name), status.st_size);
+		close(fd);
+
+		const Header* header = ring->header_;
+		std::atomic_thread_fence(std::memory_order_acquire);
+		if (header->magic != MAGIC || header->recordSize != sizeof(Record)
+				|| getSegmentSize(header->numberOfShards, header->capacity) > (size_t) status.st_size) {
+			delete ring;
+			throw std::runtime_error("Shared memory segment " + name + " does not hold rings of this record type");
+		}
+		ring->locateCells();
+		return ring;
+	}
+
+	static void remove(const std::string& name) {
+		shm_unlink(name.c_str());
+	}
+
+	~SharedMemoryRing() {
+		munmap(header_, size_);
+	}
+
+	inline uint getNumberOfShards() const {
+		return header_->numberOfShards;
+	}
+
+	inline uint getShard(uint_fast32_t eventNumber) const {
+		return eventNumber % header_->numberOfShards;
+	}
+
+	/**
+	 * May be called by any thread of any process
+	 *
+	 * @return false if the shard is full
+	 */
+	bool push(uint shardNum, const Record& record) {
+		Shard& shard = shards_[shardNum];
+		const uint64_t mask = header_->capacity - 1;
+
+		uint64_t position = shard.tail.load(std::memory_order_relaxed);
+		Cell* cell;
+		for (;;) {
+			cell = &getCell(shardNum, position & mask);
+			const int64_t difference = (int64_t) (cell->sequence.load(std::memory_order_acquire) - position);
+			if (difference == 0) {
+				if (shard.tail.compare_exchange_weak(position, position + 1, std::memory_order_relaxed)) {
+					break;
+				}
+			} else if (difference < 0) {
+				return false;
+			} else {
+				position = shard.tail.load(std::memory_order_relaxed);
+			}
+		}
+		cell->record = record;
+		cell->sequence.store(position + 1, std::memory_order_release);
+
+		std::atomic_thread_fence(std::memory_order_seq_cst);
+		if (shard.parked.load(std::memory_order_relaxed) != 0) {
+			shard.epoch.fetch_add(1, std::memory_order_release);
+			syscall(SYS_futex, reinterpret_cast<uint32_t*>(&shard.epoch), FUTEX_WAKE, 1, nullptr, nullptr, 0);
+		}
+		return true;
+	}
+
+	/**
+	 * Copies up to <maxRecords> records to <records>. May only be called by the consumer of the shard
+	 *
+	 * @return the number of records popped
+	 */
+	uint pop(uint shardNum, Record* records, uint maxRecords) {
+		Shard& shard = shards_[shardNum];
+		const uint64_t mask = header_->capacity - 1;
+
+		uint64_t position = shard.head.load(std::memory_order_relaxed);
+		uint popped = 0;
+		while (popped != maxRecords) {
+			Cell& cell = getCell(shardNum, position & mask);
+			if (cell.sequence.load(std::memory_order_acquire) != position + 1) {
+				break;
+			}
+			records[popped++] = cell.record;
+			cell.sequence.store(position + mask + 1, std::memory_order_release);
+			position++;
+		}
+		shard.head.store(position, std::memory_order_relaxed);
+		return popped;
+	}
+
+	/**
+	 * Blocks the consumer of the shard until a record is pushed or <timeoutMicros> have passed
+	 */
+	void park(uint shardNum, uint timeoutMicros) {
+		Shard& shard = shards_[shardNum];
+		const uint32_t epoch = shard.epoch.load(std::memory_order_acquire);
+		shard.parked.fetch_add(1, std::memory_order_seq_cst);
+		if (isEmpty(shardNum)) {
+			timespec timeout;
+			timeout.tv_sec = timeoutMicros / 1000000;
+			timeout.tv_nsec = (timeoutMicros % 1000000) * 1000;
+			syscall(SYS_futex, reinterpret_cast<uint32_t*>(&shard.epoch), FUTEX_WAIT, epoch, &timeout, nullptr, 0);
+		}
+		shard.parked.fetch_sub(1, std::memory_order_relaxed);
+	}
+
+	inline bool isEmpty(uint shardNum) const {
+		const uint64_t position = shards_[shardNum].head.load(std::memory_order_relaxed);
+		return getCell(shardNum, position & (header_->capacity - 1)).sequence.load(std::memory_order_acquire) != position + 1;
+	}
+
+	/*
+	 * Number of records pushed but not popped yet, including the ones being written
+	 */
+	inline uint64_t getSize(uint shardNum) const {
+		return shards_[shardNum].tail.load(std::memory_order_relaxed) - shards_[shardNum].head.load(std::memory_order_relaxed);
+	}
+
+private:
+	static const uint64_t MAGIC = 0x4e41363252494e47ull;
+
+	struct alignas(64) Header {
+		uint64_t magic;
+		uint32_t numberOfShards;
+		uint32_t capacity;
+		uint64_t recordSize;
+	};
+
+	struct alignas(64) Shard {
+		std::atomic<uint64_t> tail;
+		alignas(64) std::atomic<uint64_t> head;
+		std::atomic<uint32_t> epoch;
+		std::atomic<uint32_t> parked;
+	};
+
+	struct Cell {
+		std::atomic<uint64_t> sequence;
+		Record record;
+	};
+
+	static inline size_t getSegmentSize(uint numberOfShards, uint capacity) {
+		return sizeof(Header) + numberOfShards * sizeof(Shard) + (size_t) numberOfShards * capacity * sizeof(Cell);
+	}
+
+	static char* map(int fd, size_t size, const std::string& name) {
+		void* memory = mmap(nullptr, size, PROT_READ | PROT_WRITE, MAP_SHARED, fd, 0);
+		if (memory == MAP_FAILED) {
+			close(fd);
+			throw std::runtime_error("Unable to map the shared memory segment " + name);
+		}
+		return reinterpret_cast<char*>(memory);
+	}
+
+	SharedMemoryRing(char* memory, size_t size) :
+			header_(reinterpret_cast<Header*>(memory)), shards_(reinterpret_cast<Shard*>(memory + sizeof(Header))), cells_(
+					nullptr), size_(size) {
+	}
+
+	/**
+	 * The cells follow the shards: only known once the header is valid
+	 */
+	void locateCells() {
+		cells_ = reinterpret_cast<Cell*>(reinterpret_cast<char*>(shards_) + header_->numberOfShards * sizeof(Shard));
+	}
+
+	inline Cell& getCell(uint shardNum, uint64_t index) const {
+		return cells_[(uint64_t) shardNum * header_->capacity + index];
+	}
+
+	Header* header_;
+	Shard* shards_;
+	Cell* cells_;
+	size_t size_;
+};
+
+} /* namespace na62 */
+
+#endif /* SHAREDMEMORYRING_H_ */
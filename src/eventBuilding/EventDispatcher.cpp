@@ -0,0 +1,106 @@
+/*
+ * EventDispatcher.cpp
+ *
+ *  Created on: Oct 17, 2026
+ */
+
+#include "EventDispatcher.h"
+
+#include <monitoring/BurstIdHandler.h>
+#include <options/Logging.h>
+#include <algorithm>
+#include <sstream>
+
+#include "../utils/RateLimitedLog.h"
+
+namespace na62 {
+
+bool EventDispatcher::sharded_ = false;
+uint EventDispatcher::shardWidth_ = 1;
+uint EventDispatcher::numberOfShards_ = 1;
+EventDispatcher::Inbox* EventDispatcher::inboxes_ = nullptr;
+
+void EventDispatcher::initialize(uint numberOfTaskProcessors) {
+	sharded_ = MyOptions::GetBool(OPTION_SHARDED_EVENT_BUILDING) && numberOfTaskProcessors > 1;
+	shardWidth_ = std::max(1, MyOptions::GetInt(OPTION_EVENT_SHARD_WIDTH));
+	numberOfShards_ = numberOfTaskProcessors;
+
+	inboxes_ = new Inbox[numberOfTaskProcessors];
+	for (uint i = 0; i != numberOfTaskProcessors; i++) {
+		inboxes_[i].forwarded = 0;
+		inboxes_[i].processed = 0;
+	}
+
+	if (sharded_) {
+		LOG_INFO("Sharded event building: every " << shardWidth_ << " consecutive events are built by one of " << numberOfShards_ << " TaskProcessors");
+	}
+}
+
+bool EventDispatcher::processInbox(TaskProcessor* taskProcessor) {
+	if (!sharded_) {
+		return false;
+	}
+	Inbox& inbox = inboxes_[taskProcessor->getId()];
+	uint64_t processed = 0;
+
+	/*
+	 * Same as HandleFrameTask::dropAtEOB for the fragments forwarded before the burst is flushed
+	 */
+	if (BurstIdHandler::flushBurst()) {
+		l1::MEPFragment* l1Fragment;
+		while (inbox.l1Fragments.try_pop(l1Fragment)) {
+			delete l1Fragment;
+			processed++;
+		}
+
+		L0Work work;
+		while (inbox.l0Fragments.try_pop(work)) {
+			delete work.fragment;
+			processed++;
+		}
+
+		if (processed != 0) {
+			RateLimitedLog::report(EOB_FRAME_DROPPED, 0, BurstIdHandler::getRunNumber(), BurstIdHandler::getCurrentBurstId());
+			inbox.processed.store(inbox.processed.load(std::memory_order_relaxed) + processed, std::memory_order_release);
+		}
+		return processed != 0;
+	}
+
+	/*
+	 * CREAM data completes events which already wait for it: build them first
+	 */
+	l1::MEPFragment* l1Fragment;
+	while (inbox.l1Fragments.try_pop(l1Fragment)) {
+		L2Builder::buildEvent(l1Fragment);
+		processed++;
+	}
+
+	L0Work work;
+	while (inbox.l0Fragments.try_pop(work)) {
+		L1Builder::buildEvent(work.fragment, work.burstID, taskProcessor);
+		processed++;
+	}
+
+	if (processed != 0) {
+		inbox.processed.store(inbox.processed.load(std::memory_order_relaxed) + processed, std::memory_order_release);
+	}
+	return processed != 0;
+}
+
+std::string EventDispatcher::serializeInboxSizes() {
+	std::stringstream stream;
+	for (uint i = 0; sharded_ && i != numberOfShards_; i++) {
+		stream << i << "," << inboxes_[i].l0Fragments.unsafe_size() + inboxes_[i].l1Fragments.unsafe_size() << ";";
+	}
+	return stream.str();
+}
+
+std::string EventDispatcher::serializeForwardedFragments() {
+	std::stringstream stream;
+	for (uint i = 0; sharded_ && i != numberOfShards_; i++) {
+		stream << i << "," << inboxes_[i].forwarded << ";";
+	}
+	return stream.str();
+}
+
+} /* namespace na62 */
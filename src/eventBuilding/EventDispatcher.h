@@ -0,0 +1,127 @@
+/*
+ * EventDispatcher.h
+ *
+ * Hands fragments to the event builders. In sharded mode every event number
+ * range is owned by one TaskProcessor which builds all of its events.
+ *
+ *  Created on: Oct 17, 2026
+ */
+
+#ifndef EVENTDISPATCHER_H_
+#define EVENTDISPATCHER_H_
+
+#include <sys/types.h>
+#include <atomic>
+#include <cstdint>
+#include <string>
+#include <tbb/concurrent_queue.h>
+#include <l0/MEPFragment.h>
+#include <l1/MEPFragment.h>
+
+#include "L1Builder.h"
+#include "L2Builder.h"
+#include "../socket/TaskProcessor.h"
+
+namespace na62 {
+
+class EventDispatcher {
+public:
+	/**
+	 * Must be called before the first TaskProcessor is started
+	 */
+	static void initialize(uint numberOfTaskProcessors);
+
+	static inline bool isSharded() {
+		return sharded_;
+	}
+
+	/**
+	 * Builds the fragment in the calling thread or forwards it to the TaskProcessor owning its event
+	 */
+	static inline void buildL0Event(l0::MEPFragment* fragment, uint_fast32_t burstID, TaskProcessor* taskProcessor) {
+		if (sharded_) {
+			uint owner = getOwner(fragment->getEventNumber());
+			if (owner != taskProcessor->getId()) {
+				Inbox& inbox = inboxes_[owner];
+				inbox.forwarded.fetch_add(1, std::memory_order_relaxed);
+				inbox.l0Fragments.push( { fragment, burstID });
+				TaskProcessor::getHomeQueue(owner).getWaiter().notifyAll();
+				return;
+			}
+		}
+		L1Builder::buildEvent(fragment, burstID, taskProcessor);
+	}
+
+	static inline void buildL1Event(l1::MEPFragment* fragment, TaskProcessor* taskProcessor) {
+		if (sharded_) {
+			uint owner = getOwner(fragment->getEventNumber());
+			if (owner != taskProcessor->getId()) {
+				Inbox& inbox = inboxes_[owner];
+				inbox.forwarded.fetch_add(1, std::memory_order_relaxed);
+				inbox.l1Fragments.push(fragment);
+				TaskProcessor::getHomeQueue(owner).getWaiter().notifyAll();
+				return;
+			}
+		}
+		L2Builder::buildEvent(fragment);
+	}
+
+	/**
+	 * Builds all fragments forwarded to the given TaskProcessor. While the burst is flushed they are
+	 * dropped instead as their events are being freed by the end of burst cleanup
+	 *
+	 * @return <true> if any fragment has been processed
+	 */
+	static bool processInbox(TaskProcessor* taskProcessor);
+
+	/*
+	 * May be called by any thread: true while fragments forwarded to the given TaskProcessor are
+	 * queued or being built
+	 */
+	static inline bool hasInboxWork(TaskProcessor* taskProcessor) {
+		if (!sharded_) {
+			return false;
+		}
+		Inbox& inbox = inboxes_[taskProcessor->getId()];
+		return inbox.processed.load(std::memory_order_acquire) != inbox.forwarded.load(std::memory_order_relaxed);
+	}
+
+	/*
+	 * Format is "taskProcessorID,value;"
+	 */
+	static std::string serializeInboxSizes();
+	static std::string serializeForwardedFragments();
+
+private:
+	struct L0Work {
+		l0::MEPFragment* fragment;
+		uint_fast32_t burstID;
+	};
+
+	struct Inbox {
+		tbb::concurrent_queue<L0Work> l0Fragments;
+		tbb::concurrent_queue<l1::MEPFragment*> l1Fragments;
+		/*
+		 * Counted before the push
+		 */
+		std::atomic<uint64_t> forwarded;
+
+		/*
+		 * Only written by the owner once the fragments have been built or dropped
+		 */
+		std::atomic<uint64_t> processed;
+	};
+
+	static inline uint getOwner(uint_fast32_t eventNumber) {
+		return (eventNumber / shardWidth_) % numberOfShards_;
+	}
+
+	static bool sharded_;
+	static uint shardWidth_;
+	static uint numberOfShards_;
+	static Inbox* inboxes_;
+};
+
+} /* namespace na62 */
+
+#endif /* EVENTDISPATCHER_H_ */
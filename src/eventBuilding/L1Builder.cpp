@@ -6,6 +6,7 @@
  */
 
 #include "L1Builder.h"
+#include "L1Processor.h"
 #include "L2Builder.h"
 #ifdef USE_ERS
 #include <exceptions/CommonExceptions.h>
@@ -21,8 +22,12 @@
 #include <l1/L1TriggerProcessor.h>
 #include <sys/types.h>
 #include <cstdbool>
+#include <vector>
 #include <monitoring/HltStatistics.h>
 
+#include "../monitoring/LatencyHistograms.h"
+#include "../utils/RateLimitedLog.h"
+
 #ifdef USE_SHAREDMEMORY
 #include "SharedMemory/SharedMemoryManager.h"
 #endif
@@ -31,15 +36,16 @@
 
 namespace na62 {
 
-std::atomic<uint64_t> L1Builder::L1Requests_(0);
+ShardedCounters L1Builder::counters_(NUMBER_OF_COUNTERS);
+HltCounterHandle L1Builder::L1RequestToCreams_;
 
-std::atomic<uint64_t> L1Builder::L0BuildingTimeCumulative_(0);
-std::atomic<uint64_t> L1Builder::L0BuildingTimeMax_(0);
-std::atomic<uint64_t> L1Builder::L1ProcessingTimeCumulative_(0);
-std::atomic<uint64_t> L1Builder::L1ProcessingTimeMax_(0);
-std::atomic<uint64_t>** L1Builder::L0BuildingTimeVsEvtNumber_;
-std::atomic<uint64_t>** L1Builder::L1ProcessingTimeVsEvtNumber_;
 bool L1Builder::requestZSuppressedLkrData_;
+uint L1Builder::l1BatchSize_ = 1;
+double L1Builder::l1BatchTimeout_ = 0;
+uint L1Builder::l1LocalFraction_ = 0;
+uint L1Builder::l1LocalQueueThreshold_ = 100;
+bool L1Builder::l1LocalFallback_ = false;
+std::atomic<uint> L1Builder::triggerQueueFill_(0);
 
 //FIXME: global
 bool bypassL1=false;
@@ -63,8 +69,8 @@ void L1Builder::buildEvent(l0::MEPFragment* fragment, uint_fast32_t burstID, Tas
 	event = EventPool::getEvent(fragment->getEventNumber());
 
 	if (event == nullptr) {
-		LOG_ERROR(
-				"type = BadEv : Eliminating " << (int)(fragment->getEventNumber()) << " from source " << std::hex << (int)(fragment->getSourceID()) << ":" << (int)(fragment->getSourceSubID()) << std::dec);
+		RateLimitedLog::report(L0_FRAGMENT_DROPPED, fragment->getSourceID() << 16 | fragment->getSourceSubID(),
+				fragment->getEventNumber());
 
 		delete fragment;
 		return;
@@ -84,21 +90,7 @@ void L1Builder::buildEvent(l0::MEPFragment* fragment, uint_fast32_t burstID, Tas
 		event->setTimestamp(tsFragment->getTimestamp());
 
 #ifdef MEASURE_TIME
-		uint L0BuildingTimeIndex = (uint) event->getL0BuildingTime() / 5000.;
-		//uint L0BuildingTimeIndex = (uint) (event->getL0BuildingTime() / 1000. + 0.5);
-		if (L0BuildingTimeIndex >= 0x64) {
-			L0BuildingTimeIndex = 0x64;
-		}
-		uint EventTimestampIndex = (uint) ((event->getTimestamp() * 25e-8));
-		if (EventTimestampIndex >= 0x64) {
-			EventTimestampIndex = 0x64;
-		}
-		L0BuildingTimeVsEvtNumber_[L0BuildingTimeIndex][EventTimestampIndex].fetch_add(1, std::memory_order_relaxed);
-
-		L0BuildingTimeCumulative_.fetch_add(event->getL0BuildingTime(), std::memory_order_relaxed);
-		if (event->getL0BuildingTime() >= L0BuildingTimeMax_) {
-			L0BuildingTimeMax_ = event->getL0BuildingTime();
-		}
+		LatencyHistograms::record(L0_BUILDING_TIME, event->getL0BuildingTime());
 #endif
 		event->readTriggerTypeWordAndFineTime();
 		/*
@@ -117,19 +109,33 @@ void L1Builder::processL1(Event *event, TaskProcessor* taskProcessor) {
 	 * Send L1 to trigger processor
 	 */
 	bypassL1 = false;
+	if (isProcessedLocally(event)) {
+		counters_.increment(L1_LOCAL_EVENTS);
+		processL1Locally(event, taskProcessor);
+		return;
+	}
+
 	if (SharedMemoryManager::storeL1Event(event)) {
 		//Counting just event successfully sent in the shared memory
 		//LOG_ERROR("Serialized on the shared memory");
 		uint amount = 1;
 		SharedMemoryManager::setEventOut(event->getBurstID(), amount);
+		counters_.increment(L1_REMOTE_EVENTS);
+
+	} else if (l1LocalFallback_) {
+		/*
+		 * The trigger processes can't keep up: process the event here instead of accepting it blindly
+		 */
+		counters_.increment(L1_LOCAL_FALLBACK_EVENTS);
+		processL1Locally(event, taskProcessor);
 
 	} else {
-		//TODO unable to store on the shared memory can process it locally?
 		//LOG_ERROR("Unable to serialize event " << (int) event->getEventNumber()  << " on the shared memory. -> send L1 request");
 		// send L1 request!
 		uint_fast8_t l1TriggerTypeWord = 0x20;
 		uint_fast8_t l0TriggerTypeWord = event->getL0TriggerTypeWord(); //special trigger word to mark these events
 		HltStatistics::updateL1Statistics(event, l1TriggerTypeWord);
+		counters_.increment(L1_BLINDLY_ACCEPTED_EVENTS);
 
 		uint_fast16_t L0L1Trigger(l0TriggerTypeWord | l1TriggerTypeWord << 8);
 		event->setL1Processed(L0L1Trigger);
@@ -144,13 +150,65 @@ void L1Builder::processL1(Event *event, TaskProcessor* taskProcessor) {
 	}
 
 #else
+	processL1Locally(event, taskProcessor);
+#endif
+}
 
+#ifdef USE_SHAREDMEMORY
+bool L1Builder::isProcessedLocally(Event *event) {
+	/*
+	 * Reading the queue depth locks the queue: only every 64th event of a thread updates it
+	 */
+	static thread_local uint eventsSinceQueueCheck = 0;
+	if (l1LocalQueueThreshold_ < 100 && eventsSinceQueueCheck++ % 64 == 0) {
+		const boost::interprocess::message_queue* queue = SharedMemoryManager::getTriggerQueue();
+		triggerQueueFill_.store(queue->get_num_msg() * 100 / std::max(queue->get_max_msg(), (size_t) 1),
+				std::memory_order_relaxed);
+	}
+
+	/*
+	 * l1LocalFraction while the queue is filled below l1LocalQueueThreshold, then rising linearly to all
+	 * events for a full queue
+	 */
+	uint localPercent = l1LocalFraction_;
+	const uint fill = triggerQueueFill_.load(std::memory_order_relaxed);
+	if (fill > l1LocalQueueThreshold_) {
+		localPercent = std::max(localPercent, (fill - l1LocalQueueThreshold_) * 100 / (100 - l1LocalQueueThreshold_));
+	}
+	if (localPercent == 0) {
+		return false;
+	}
+
+	/*
+	 * Hash of the event number: the same events are chosen however the events are distributed to the threads
+	 */
+	return (event->getEventNumber() * 2654435761u) % 100 < localPercent;
+}
+#endif
+
+void L1Builder::processL1Locally(Event *event, TaskProcessor* taskProcessor) {
+	if (L1Processor::isEnabled()) {
+		L1Processor::push(event);
+		return;
+	}
+
+	if (l1BatchSize_ > 1) {
+		if (taskProcessor->addToL1Batch(event) >= l1BatchSize_) {
+			taskProcessor->processL1Batch();
+		}
+		return;
+	}
+
+	finishL1(event, computeL1(event, taskProcessor->getStrawAlgo()));
+}
+
+uint_fast8_t L1Builder::computeL1(Event *event, StrawAlgo& strawAlgo) {
 	/*
 	 * Process Level 1 trigger
 	 */
 
 	uint_fast8_t l0TriggerTypeWord = event->getL0TriggerTypeWord();
-	uint_fast8_t l1TriggerTypeWord = L1TriggerProcessor::compute(event, taskProcessor->getStrawAlgo());
+	uint_fast8_t l1TriggerTypeWord = L1TriggerProcessor::compute(event, strawAlgo);
 	/*STATISTICS*/
 	HltStatistics::updateL1Statistics(event, l1TriggerTypeWord);
 
@@ -158,26 +216,20 @@ void L1Builder::processL1(Event *event, TaskProcessor* taskProcessor) {
 	event->setL1Processed(L0L1Trigger);
 
 #ifdef MEASURE_TIME
-	uint L1ProcessingTimeIndex = (uint) event->getL1ProcessingTime() / 10;
-	//uint L1ProcessingTimeIndex = (uint) event->getL1ProcessingTime() + 0.5;
-	if (L1ProcessingTimeIndex >= 0x64) {
-		L1ProcessingTimeIndex = 0x64;
-	}
-	uint EventTimestampIndex = (uint) ((event->getTimestamp() * 25e-08));
-	//uint EventTimestampIndex = (uint) (event->getTimestamp() * 25e-8);
-	if (EventTimestampIndex >= 0x64) {
-		EventTimestampIndex = 0x64;
-	}
-	L1ProcessingTimeVsEvtNumber_[L1ProcessingTimeIndex][EventTimestampIndex].fetch_add(1, std::memory_order_relaxed);
-	L1ProcessingTimeCumulative_.fetch_add(event->getL1ProcessingTime(), std::memory_order_relaxed);
-	if (event->getL1ProcessingTime() >= L1ProcessingTimeMax_) {
-		L1ProcessingTimeMax_ = event->getL1ProcessingTime();
-	}
+	LatencyHistograms::record(L1_PROCESSING_TIME, event->getL1ProcessingTime());
 #endif
+	return l1TriggerTypeWord;
+}
+
+void L1Builder::finishL1(Event *event, uint_fast8_t l1TriggerTypeWord) {
 	if (l1TriggerTypeWord != 0) {
 
 		if (SourceIDManager::NUMBER_OF_EXPECTED_L1_PACKETS_PER_EVENT != 0) {
 			sendL1Request(event);
+#ifdef USE_SHAREDMEMORY
+			event->setL1Requested();
+			SharedMemoryManager::setEventL1Requested(event->getBurstID(), 1);
+#endif
 		} else {
 			L2Builder::processL2(event);
 		}
@@ -187,7 +239,33 @@ void L1Builder::processL1(Event *event, TaskProcessor* taskProcessor) {
 		 */
 		EventPool::freeEvent(event);
 	}
-#endif
+}
+
+void L1Builder::processL1Batch(std::vector<L1BatchEntry>& batch, StrawAlgo& strawAlgo) {
+	if (batch.empty()) {
+		return;
+	}
+
+	const tbb::tick_count now = tbb::tick_count::now();
+	for (L1BatchEntry& entry : batch) {
+		LatencyHistograms::record(L1_BATCH_WAIT_TIME, (now - entry.completionTime).seconds() * 1E6);
+	}
+
+	const uint size = batch.size();
+	for (uint i = 0; i != size; i++) {
+		if (i + 1 != size) {
+			__builtin_prefetch(batch[i + 1].event);
+		}
+		batch[i].l1TriggerTypeWord = computeL1(batch[i].event, strawAlgo);
+	}
+
+	for (L1BatchEntry& entry : batch) {
+		finishL1(entry.event, entry.l1TriggerTypeWord);
+	}
+
+	counters_.increment(L1_BATCHES);
+	counters_.add(L1_BATCHED_EVENTS, size);
+	batch.clear();
 }
 
 void L1Builder::sendL1Request(Event* event) {
@@ -195,9 +273,9 @@ void L1Builder::sendL1Request(Event* event) {
 	// See https://github.com/NA62/na62-trigger-algorithms/wiki/CREAM-data
 	l1::L1DistributionHandler::Async_RequestL1DataMulticast(event,
 			event->isRrequestZeroSuppressedCreamData() && requestZSuppressedLkrData_);
-	L1Requests_.fetch_add(1, std::memory_order_relaxed);
+	counters_.increment(L1_REQUESTS);
 
-	HltStatistics::sumCounter("L1RequestToCreams", 1);
+	HltCounters::sum(L1RequestToCreams_, 1);
 }
 }
 /* namespace na62 */
@@ -9,11 +9,15 @@
 #define L1BUILDER_H_
 
 #include <tbb/task.h>
+#include <algorithm>
 #include <atomic>
 #include <cstdint>
+#include <vector>
 
 #include "../options/MyOptions.h"
 #include "../socket/TaskProcessor.h"
+#include "../utils/ShardedCounters.h"
+#include "../monitoring/HltCounters.h"
 namespace na62 {
 class Event;
 namespace l0 {
@@ -25,19 +29,61 @@ namespace na62 {
 
 class L1Builder {
 private:
-	static std::atomic<uint64_t> L1Requests_;
-
-	static std::atomic<uint64_t> L0BuildingTimeCumulative_;
-	static std::atomic<uint64_t> L0BuildingTimeMax_;
-	static std::atomic<uint64_t> L1ProcessingTimeCumulative_;
-	static std::atomic<uint64_t> L1ProcessingTimeMax_;
-	static std::atomic<uint64_t>** L0BuildingTimeVsEvtNumber_;
-	static std::atomic<uint64_t>** L1ProcessingTimeVsEvtNumber_;
+	enum Counter : uint {
+		L1_REQUESTS,
+		L1_BATCHES,
+		L1_BATCHED_EVENTS,
+		L1_REMOTE_EVENTS,
+		L1_LOCAL_EVENTS,
+		L1_LOCAL_FALLBACK_EVENTS,
+		L1_BLINDLY_ACCEPTED_EVENTS,
+		NUMBER_OF_COUNTERS
+	};
+	static ShardedCounters counters_;
+
+	static HltCounterHandle L1RequestToCreams_;
 
 	static void processL1(Event *event, TaskProcessor* taskProcessor);
 
+	/**
+	 * Runs the L1 trigger within this process: in the calling TaskProcessor, batched or in the L1Processors
+	 */
+	static void processL1Locally(Event *event, TaskProcessor* taskProcessor);
+
+#ifdef USE_SHAREDMEMORY
+	/**
+	 * Decides whether the event is processed locally instead of by the external trigger processes,
+	 * depending on l1LocalFraction and the filling of the shared memory trigger queue
+	 */
+	static bool isProcessedLocally(Event *event);
+#endif
+
+	/**
+	 * Runs the L1 trigger algorithms on the event and updates the L1 statistics
+	 */
+	static uint_fast8_t computeL1(Event *event, StrawAlgo& strawAlgo);
+
+	/**
+	 * Requests the CREAM data, processes L2 or frees the event depending on the L1 decision
+	 */
+	static void finishL1(Event *event, uint_fast8_t l1TriggerTypeWord);
+
 	static bool requestZSuppressedLkrData_;
 
+	/*
+	 * Events are processed one by one if l1BatchSize_ <= 1
+	 */
+	static uint l1BatchSize_;
+	static double l1BatchTimeout_;
+
+	/*
+	 * Split between local and external L1 processing, all in percent
+	 */
+	static uint l1LocalFraction_;
+	static uint l1LocalQueueThreshold_;
+	static bool l1LocalFallback_;
+	static std::atomic<uint> triggerQueueFill_;
+
 public:
 
 	/*
@@ -53,80 +99,71 @@ public:
 	 */
 	static void buildEvent(l0::MEPFragment* fragment, uint_fast32_t burstID, TaskProcessor* taskProcessor);
 
-	static inline std::atomic<uint64_t>** GetL0BuidingTimeVsEvtNumber() {
-		return L0BuildingTimeVsEvtNumber_;
-	}
-
-	static void ResetL0BuidingTimeVsEvtNumber() {
-		for (int i = 0; i < 0x64 + 1; ++i) {
-			for (int j = 0; j < 0x64 + 1; ++j) {
-				L0BuildingTimeVsEvtNumber_[i][j] = 0;
-			}
-		}
-	}
-
-	static inline std::atomic<uint64_t>** GetL1ProcessingTimeVsEvtNumber() {
-		return L1ProcessingTimeVsEvtNumber_;
-	}
+	/**
+	 * Runs the L1 trigger over all events of the batch and clears it. The algorithms are executed for
+	 * the whole batch first so that their code and tables stay in the caches, then the accepted events
+	 * are requested or passed to L2.
+	 */
+	static void processL1Batch(std::vector<L1BatchEntry>& batch, StrawAlgo& strawAlgo);
 
-	static void ResetL1ProcessingTimeVsEvtNumber() {
-		for (int i = 0; i < 0x64 + 1; ++i) {
-			for (int j = 0; j < 0x64 + 1; ++j) {
-				L1ProcessingTimeVsEvtNumber_[i][j] = 0;
-			}
-		}
+	/**
+	 * @return true if the oldest event of a batch has waited for l1BatchTimeout
+	 */
+	static inline bool isL1BatchDue(const L1BatchEntry& oldestEntry) {
+		return (tbb::tick_count::now() - oldestEntry.completionTime).seconds() >= l1BatchTimeout_;
 	}
 
 	static inline uint64_t GetL1Requests() {
-		return L1Requests_;
-	}
-
-	static inline uint64_t GetL1ProcessingTimeCumulative() {
-		return L1ProcessingTimeCumulative_;
+		return counters_.get(L1_REQUESTS);
 	}
 
-	static void ResetL1ProcessingTimeCumulative() {
-		L1ProcessingTimeCumulative_ = 0;
+	static inline uint64_t GetL1Batches() {
+		return counters_.get(L1_BATCHES);
 	}
 
-	static inline uint64_t GetL0BuildingTimeCumulative() {
-		return L0BuildingTimeCumulative_;
+	static inline uint64_t GetL1BatchedEvents() {
+		return counters_.get(L1_BATCHED_EVENTS);
 	}
 
-	static void ResetL0BuildingTimeCumulative() {
-		L0BuildingTimeCumulative_ = 0;
+	/*
+	 * Events processed by the external trigger processes, locally by choice, locally as the trigger queue
+	 * was full and accepted without processing as the trigger queue was full
+	 */
+	static inline uint64_t GetL1RemoteEvents() {
+		return counters_.get(L1_REMOTE_EVENTS);
 	}
 
-	static inline uint64_t GetL1ProcessingTimeMax() {
-		return L1ProcessingTimeMax_;
+	static inline uint64_t GetL1LocalEvents() {
+		return counters_.get(L1_LOCAL_EVENTS);
 	}
 
-	static void ResetL1ProcessingTimeMax() {
-		L1ProcessingTimeMax_ = 0;
+	static inline uint64_t GetL1LocalFallbackEvents() {
+		return counters_.get(L1_LOCAL_FALLBACK_EVENTS);
 	}
 
-	static inline uint64_t GetL0BuildingTimeMax() {
-		return L0BuildingTimeMax_;
+	static inline uint64_t GetL1BlindlyAcceptedEvents() {
+		return counters_.get(L1_BLINDLY_ACCEPTED_EVENTS);
 	}
 
-	static void ResetL0BuildingTimeMax() {
-		L0BuildingTimeMax_ = 0;
+	/*
+	 * Filling of the shared memory trigger queue in percent as last seen by the TaskProcessors
+	 */
+	static inline uint GetTriggerQueueFill() {
+		return triggerQueueFill_.load(std::memory_order_relaxed);
 	}
 
 	static void initialize() {
-		L0BuildingTimeVsEvtNumber_ = new std::atomic<uint64_t>*[0x64 + 1];
-		L1ProcessingTimeVsEvtNumber_ = new std::atomic<uint64_t>*[0x64 + 1];
-		for (int i = 0; i < 0x64 + 1; i++) {
-			L0BuildingTimeVsEvtNumber_[i] =
-					new std::atomic<uint64_t>[0x64 + 1] { };
-			L1ProcessingTimeVsEvtNumber_[i] =
-					new std::atomic<uint64_t>[0x64 + 1] { };
-		}
-		L1Builder::ResetL0BuidingTimeVsEvtNumber();
-		L1Builder::ResetL1ProcessingTimeVsEvtNumber();
+		L1RequestToCreams_ = HltCounters::registerCounter("L1RequestToCreams");
 
 		requestZSuppressedLkrData_ = MyOptions::GetBool(
 		OPTION_SEND_MRP_WITH_ZSUPPRESSION_FLAG);
+
+		l1BatchSize_ = MyOptions::GetInt(OPTION_L1_BATCH_SIZE);
+		l1BatchTimeout_ = MyOptions::GetInt(OPTION_L1_BATCH_TIMEOUT) / 1E6;
+
+		l1LocalFraction_ = std::min(std::max(MyOptions::GetInt(OPTION_L1_LOCAL_FRACTION), 0), 100);
+		l1LocalQueueThreshold_ = std::min(std::max(MyOptions::GetInt(OPTION_L1_LOCAL_QUEUE_THRESHOLD), 0), 100);
+		l1LocalFallback_ = MyOptions::GetBool(OPTION_L1_LOCAL_FALLBACK);
 	}
 };
 
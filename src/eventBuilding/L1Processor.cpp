@@ -0,0 +1,97 @@
+/*
+ * L1Processor.cpp
+ *
+ *  Created on: Oct 18, 2026
+ */
+
+#include "L1Processor.h"
+
+#include <unistd.h>
+#include <algorithm>
+
+#include <options/Logging.h>
+
+#include "L1Builder.h"
+#include "../options/MyOptions.h"
+
+namespace na62 {
+
+uint L1Processor::numberOfProcessors_ = 0;
+uint L1Processor::batchSize_ = 1;
+tbb::concurrent_queue<L1BatchEntry> L1Processor::queue_;
+std::atomic<int> L1Processor::queuedEvents_(0);
+IdleWaiter L1Processor::waiter_;
+ThreadOccupancy L1Processor::occupancy_;
+
+L1Processor::L1Processor(uint processorID) :
+		running_(true), stopped_(false), processorID_(processorID) {
+	batch_.reserve(batchSize_);
+}
+
+L1Processor::~L1Processor() {
+}
+
+void L1Processor::initialize() {
+	numberOfProcessors_ = std::max(MyOptions::GetInt(OPTION_L1_PROCESSORS), 0);
+	batchSize_ = std::max(MyOptions::GetInt(OPTION_L1_BATCH_SIZE), 1);
+	waiter_.configure(MyOptions::GetInt(OPTION_TP_IDLE_SPINS), MyOptions::GetInt(OPTION_TP_IDLE_YIELDS),
+			MyOptions::GetInt(OPTION_IDLE_PARK_TIMEOUT));
+	occupancy_.initialize(numberOfProcessors_);
+
+	if (isEnabled()) {
+		LOG_INFO("Running the L1 trigger in " << numberOfProcessors_ << " L1Processors");
+	}
+}
+
+void L1Processor::thread() {
+	uint unsuccessfulPolls = 0;
+	while (running_) {
+		const tbb::tick_count start = tbb::tick_count::now();
+
+		/*
+		 * Take whatever is queued up to the batch size: waiting for more would only add latency
+		 */
+		L1BatchEntry entry;
+		while (batch_.size() != batchSize_ && queue_.try_pop(entry)) {
+			batch_.push_back(entry);
+		}
+
+		if (batch_.empty()) {
+			waiter_.idle(unsuccessfulPolls++, []() {
+				return !queue_.empty();
+			});
+			continue;
+		}
+
+		/*
+		 * Only counted down once processed: the end of burst cleanup waits for the count to drop to 0
+		 */
+		const uint size = batch_.size();
+		L1Builder::processL1Batch(batch_, strawAlgo_);
+		queuedEvents_.fetch_sub(size, std::memory_order_release);
+		occupancy_.addBusyTime(processorID_, start);
+		unsuccessfulPolls = 0;
+	}
+	stopped_ = true;
+}
+
+void L1Processor::onInterruption() {
+	running_ = false;
+}
+
+void L1Processor::stop() {
+	running_ = false;
+	waiter_.notifyAll();
+
+	/*
+	 * The thread may have been terminated by an interruption before leaving its loop
+	 */
+	for (uint polls = 0; !stopped_ && polls != 10000; polls++) {
+		usleep(100);
+	}
+	if (!stopped_) {
+		LOG_ERROR("L1Processor " << processorID_ << " did not stop");
+	}
+}
+
+} /* namespace na62 */
@@ -0,0 +1,107 @@
+/*
+ * L1Processor.h
+ *
+ * Thread of the L1 compute pool
+ *
+ *  Created on: Oct 18, 2026
+ */
+
+#ifndef L1PROCESSOR_H_
+#define L1PROCESSOR_H_
+
+#include <sys/types.h>
+#include <atomic>
+#include <string>
+#include <vector>
+#include <tbb/concurrent_queue.h>
+#include <tbb/tick_count.h>
+#include <utils/AExecutable.h>
+#include <l1/StrawAlgo.h>
+
+#include "../socket/IdleWaiter.h"
+#include "../socket/TaskProcessor.h"
+#include "../utils/ThreadOccupancy.h"
+
+namespace na62 {
+
+class Event;
+
+/*
+ * With l1Processors > 0 the TaskProcessors only build the events: every event complete at L0 is
+ * pushed to one queue shared by a separately sized and pinned pool of L1Processors which run the
+ * L1 trigger, so a slow L1 algorithm no longer delays the processing of the received frames.
+ * With shared memory only the events processed locally are pushed, see L1Builder::processL1().
+ */
+class L1Processor: public AExecutable {
+public:
+	L1Processor(uint processorID);
+	virtual ~L1Processor();
+
+	/**
+	 * Reads the size of the pool. Must be called before the first TaskProcessor is started
+	 */
+	static void initialize();
+
+	static inline bool isEnabled() {
+		return numberOfProcessors_ != 0;
+	}
+
+	static inline uint getNumberOfProcessors() {
+		return numberOfProcessors_;
+	}
+
+	/**
+	 * Called by the TaskProcessors with every event complete at L0
+	 */
+	static inline void push(Event* event) {
+		queuedEvents_.fetch_add(1, std::memory_order_relaxed);
+		queue_.push(L1BatchEntry { event, tbb::tick_count::now(), 0 });
+		waiter_.notifyOne();
+	}
+
+	/*
+	 * Number of events waiting for or being processed by the L1 trigger
+	 */
+	static inline int getQueueSize() {
+		return queuedEvents_.load(std::memory_order_relaxed);
+	}
+
+	static std::string serializeOccupancy() {
+		return occupancy_.serialize();
+	}
+
+	static uint64_t getNumberOfParks() {
+		return waiter_.getNumberOfParks();
+	}
+
+	/**
+	 * Stops the thread after its current batch and waits until it has returned
+	 */
+	void stop();
+
+private:
+	virtual void thread() override;
+	virtual void onInterruption() override;
+
+	static uint numberOfProcessors_;
+
+	/*
+	 * Maximum number of events processed in one go, see l1BatchSize
+	 */
+	static uint batchSize_;
+
+	static tbb::concurrent_queue<L1BatchEntry> queue_;
+	static std::atomic<int> queuedEvents_;
+	static IdleWaiter waiter_;
+	static ThreadOccupancy occupancy_;
+
+	std::atomic<bool> running_;
+	std::atomic<bool> stopped_;
+	uint processorID_;
+	StrawAlgo strawAlgo_;
+	std::vector<L1BatchEntry> batch_;
+};
+
+} /* namespace na62 */
+
+#endif /* L1PROCESSOR_H_ */
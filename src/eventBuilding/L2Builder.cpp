@@ -28,16 +28,10 @@
 #include <monitoring/HltStatistics.h>
 #include <structs/LkrCrateSlotDecoder.h>
 
-namespace na62 {
-
-std::atomic<uint64_t> L2Builder::L1BuildingTimeCumulative_(0);
-std::atomic<uint64_t> L2Builder::L1BuildingTimeMax_(0);
-std::atomic<uint64_t> L2Builder::L2ProcessingTimeCumulative_(0);
-std::atomic<uint64_t> L2Builder::L2ProcessingTimeMax_(0);
+#include "../monitoring/LatencyHistograms.h"
+#include "../utils/RateLimitedLog.h"
 
-std::atomic<uint64_t>** L2Builder::L1BuildingTimeVsEvtNumber_;
-std::atomic<uint64_t>** L2Builder::L2ProcessingTimeVsEvtNumber_;
-std::atomic<uint64_t>** L2Builder::SerializationTimeVsEvtNumber_;
+namespace na62 {
 
 void L2Builder::buildEvent(l1::MEPFragment* fragment) {
 	Event * event = nullptr;
@@ -64,12 +58,8 @@ void L2Builder::buildEvent(l1::MEPFragment* fragment) {
 	 * If the event number is too large event is null and we have to drop the data
 	 */
 	if (event == nullptr) {
-
-		uint crateID = (fragment->getSourceSubID() >> 5) & 0x3f;
-		uint creamID = fragment->getSourceSubID() & 0x1f;
-
-		LOG_ERROR(
-				"type = BadEv : Eliminating " << std::hex << (int)(fragment->getEventNumber()) << " from source = 0x" << std::hex << (int)(fragment->getSourceID()) << ":0x" << (int)(fragment->getSourceSubID()) << std::dec << " -- "<< crateID << "--" << creamID);
+		RateLimitedLog::report(L1_FRAGMENT_DROPPED, fragment->getSourceID() << 16 | fragment->getSourceSubID(),
+				fragment->getEventNumber());
 		delete fragment;
 		return;
 	}
@@ -81,22 +71,7 @@ void L2Builder::buildEvent(l1::MEPFragment* fragment) {
 
 	if (event->addL1Fragment(fragment)) {
 #ifdef MEASURE_TIME
-		uint L1BuildingTimeIndex = (uint) event->getL1BuildingTime() / 10000.;
-		//uint L1BuildingTimeIndex = (uint) (event->getL1BuildingTime() / 1000. + 0.5);
-		if (L1BuildingTimeIndex >= 0x64) {
-			L1BuildingTimeIndex = 0x64;
-		}
-		uint EventTimestampIndex = (uint) ((event->getTimestamp() * 25e-8));
-		if (EventTimestampIndex >= 0x64) {
-			EventTimestampIndex = 0x64;
-		}
-		L1BuildingTimeVsEvtNumber_[L1BuildingTimeIndex][EventTimestampIndex].fetch_add(
-				1, std::memory_order_relaxed);
-		L1BuildingTimeCumulative_.fetch_add(event->getL1BuildingTime(),
-				std::memory_order_relaxed);
-		if (event->getL0BuildingTime() >= L1BuildingTimeMax_) {
-			L1BuildingTimeMax_ = event->getL1BuildingTime();
-		}
+		LatencyHistograms::record(L1_BUILDING_TIME, event->getL1BuildingTime());
 #endif
 
 		/*
@@ -127,21 +102,7 @@ void L2Builder::processL2(Event *event) {
 			HltStatistics::updateL2Statistics(event, L2Trigger);
 			event->setL2Processed(L2Trigger);
 #ifdef MEASURE_TIME
-			uint L2ProcessingTimeIndex = (uint) event->getL2ProcessingTime() / 1.;
-			//uint L2ProcessingTimeIndex = (uint) event->getL2ProcessingTime() + 0.5;
-			if (L2ProcessingTimeIndex >= 0x64) {
-				L2ProcessingTimeIndex = 0x64;
-			}
-			uint EventTimestampIndex = (uint) ((event->getTimestamp() * 25e-8));
-			if (EventTimestampIndex >= 0x64) {
-				EventTimestampIndex = 0x64;
-			}
-			L2ProcessingTimeVsEvtNumber_[L2ProcessingTimeIndex][EventTimestampIndex].fetch_add(1, std::memory_order_relaxed);
-
-			L2ProcessingTimeCumulative_.fetch_add(event->getL2ProcessingTime(),	std::memory_order_relaxed);
-			if (event->getL2ProcessingTime() >= L2ProcessingTimeMax_) {
-				L2ProcessingTimeMax_ = event->getL2ProcessingTime();
-			}
+			LatencyHistograms::record(L2_PROCESSING_TIME, event->getL2ProcessingTime());
 #endif
 			/*
 			 * Event has been processed and saved or rejected -> destroy, don't delete so that it can be reused if
@@ -155,16 +116,7 @@ void L2Builder::processL2(Event *event) {
 					uint64_t BytesSentToStorage = StorageHandler::SendEvent(event);
 #ifdef MEASURE_TIME
 					event->setSerializationTime();
-					uint SerializationTimeIndex = (uint) event->getSerializationTime();
-
-					if (SerializationTimeIndex >= 0x64) {
-						SerializationTimeIndex = 0x64;
-					}
-					uint EventTimestampIndex = (uint) ((event->getTimestamp() * 25e-8));
-					if (EventTimestampIndex >= 0x64) {
-						EventTimestampIndex = 0x64;
-					}
-					SerializationTimeVsEvtNumber_[SerializationTimeIndex][EventTimestampIndex].fetch_add(1, std::memory_order_relaxed);
+					LatencyHistograms::record(SERIALIZATION_TIME, event->getSerializationTime());
 #endif
 					/*STATISTICS*/
 					HltStatistics::updateStorageStatistics(BytesSentToStorage);
@@ -180,11 +132,7 @@ void L2Builder::processL2(Event *event) {
 
 			event->setL2Processed(L2Trigger);
 #ifdef MEASURE_TIME
-			L2ProcessingTimeCumulative_.fetch_add(event->getL2ProcessingTime(),
-					std::memory_order_relaxed);
-			if (event->getL2ProcessingTime() >= L2ProcessingTimeMax_) {
-				L2ProcessingTimeMax_ = event->getL2ProcessingTime();
-			}
+			LatencyHistograms::record(L2_PROCESSING_TIME, event->getL2ProcessingTime());
 #endif
 			//if (event->isL2Accepted()) {
 				//BytesSentToStorage_.fetch_add(StorageHandler::SendEvent(event),
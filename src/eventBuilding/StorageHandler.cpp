@@ -33,6 +33,7 @@ namespace na62 {
 
 std::vector<zmq::socket_t*> StorageHandler::mergerSockets_;
 tbb::concurrent_queue<const EVENT_HDR*> StorageHandler::DataQueue_;
+IdleWaiter StorageHandler::waiter_;
 
 std::recursive_mutex StorageHandler::sendMutex_;
 
@@ -58,6 +59,8 @@ void StorageHandler::setMergers(std::vector<std::string> mergerList) {
 }
 
 void StorageHandler::initialize() {
+	waiter_.configure(Options::GetInt(OPTION_SH_IDLE_SPINS), Options::GetInt(OPTION_SH_IDLE_YIELDS),
+			Options::GetInt(OPTION_IDLE_PARK_TIMEOUT));
 	setMergers(Options::GetStringList(OPTION_MERGER_HOST_NAMES));
 }
 
@@ -77,13 +80,16 @@ int StorageHandler::SendEvent(const Event* event) {
 	int dataLength = data->length * 4;
 
 	StorageHandler::DataQueue_.push(data);
+	waiter_.notifyOne();
 	return dataLength;
 }
 
 void StorageHandler::thread() {
+	uint unsuccessfulPolls = 0;
 	while (running_) {
 		const EVENT_HDR* data;
 		if (StorageHandler::DataQueue_.try_pop(data)) {
+			unsuccessfulPolls = 0;
 			try {
 				zmq::message_t zmqMessage((void*) data, data->length * 4,
 						(zmq::free_fn*) ZMQHandler::freeZmqMessage);
@@ -111,7 +117,9 @@ void StorageHandler::thread() {
 			}
 		}
 		else {
-			boost::this_thread::sleep(boost::posix_time::microsec(50));
+			waiter_.idle(unsuccessfulPolls++, []() {
+				return !DataQueue_.empty();
+			});
 		}
 	}
 }
@@ -18,6 +18,8 @@
 #include <tbb/concurrent_queue.h>
 #include <storage/EventSerializer.h>
 
+#include "../socket/IdleWaiter.h"
+
 namespace zmq {
 class socket_t;
 class message_t;
@@ -41,6 +43,10 @@ public:
 	 */
 	static void setMergers(std::vector<std::string> mergerList);
 
+	static inline const IdleWaiter& getWaiter() {
+		return waiter_;
+	}
+
 private:
 	virtual void thread() override;
 	virtual void onInterruption() override;
@@ -48,6 +54,7 @@ private:
 
 //	static std::vector<std::string> GetMergerAddresses(std::string mergerList);
 	static tbb::concurrent_queue<const EVENT_HDR*> DataQueue_;
+	static IdleWaiter waiter_;
 	/*
 	 * One Socket for every EventBuilder
 	 */
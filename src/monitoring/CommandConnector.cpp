@@ -24,6 +24,8 @@
 #include "../eventBuilding/StorageHandler.h"
 #include "../options/MyOptions.h"
 #include "../socket/PacketHandler.h"
+#include "../socket/ChecksumVerifier.h"
+#include "LatencyHistograms.h"
 #include "../eventBuilding/L1Builder.h"
 #include "../eventBuilding/L2Builder.h"
 #include <l1/L1TriggerProcessor.h>
@@ -77,6 +79,10 @@ void CommandConnector::thread() {
 			}
 		} else if (command == "sob_timestamp") {
 			BurstIdHandler::setSOBTime(atoi(strings[1].c_str()));
+		} else if (command == "checksumverification") {
+			ChecksumVerifier::setMode(atoi(strings[1].c_str()));
+		} else if (command == "latencyhistograms") {
+			LatencyHistograms::setEnabled(atoi(strings[1].c_str()) != 0);
 		} else {
 			LOG_INFO("Ignore command received: " << message);
 		}
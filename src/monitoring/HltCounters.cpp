@@ -0,0 +1,49 @@
+/*
+ * HltCounters.cpp
+ *
+ *  Created on: Oct 17, 2026
+ */
+
+#include "HltCounters.h"
+
+#include <stdexcept>
+
+#include <monitoring/HltStatistics.h>
+#include <options/Logging.h>
+
+namespace na62 {
+
+ShardedCounters HltCounters::counters_(MAX_COUNTERS);
+std::vector<std::string> HltCounters::names_;
+uint64_t HltCounters::flushed_[MAX_COUNTERS];
+std::mutex HltCounters::flushMutex_;
+
+HltCounterHandle HltCounters::registerCounter(std::string name) {
+	std::lock_guard<std::mutex> lock(flushMutex_);
+	for (uint handle = 0; handle != names_.size(); handle++) {
+		if (names_[handle] == name) {
+			return handle;
+		}
+	}
+
+	if (names_.size() == MAX_COUNTERS) {
+		LOG_ERROR("Too many HLT counters registered, can not register " << name);
+		throw std::length_error("HltCounters::MAX_COUNTERS exceeded");
+	}
+	flushed_[names_.size()] = 0;
+	names_.push_back(name);
+	return names_.size() - 1;
+}
+
+void HltCounters::flush() {
+	std::lock_guard<std::mutex> lock(flushMutex_);
+	for (uint handle = 0; handle != names_.size(); handle++) {
+		const uint64_t value = counters_.get(handle);
+		if (value != flushed_[handle]) {
+			HltStatistics::sumCounter(names_[handle], value - flushed_[handle]);
+			flushed_[handle] = value;
+		}
+	}
+}
+
+} /* namespace na62 */
@@ -0,0 +1,54 @@
+/*
+ * HltCounters.h
+ *
+ * Handles to HltStatistics counters for code running per event
+ *
+ *  Created on: Oct 17, 2026
+ */
+
+#ifndef HLTCOUNTERS_H_
+#define HLTCOUNTERS_H_
+
+#include <sys/types.h>
+#include <cstdint>
+#include <mutex>
+#include <string>
+#include <vector>
+
+#include "../utils/ShardedCounters.h"
+
+namespace na62 {
+
+typedef uint HltCounterHandle;
+
+/*
+ * HltStatistics::sumCounter looks up its counter by name on every call. Counters bumped per event
+ * are registered here once instead and incremented via their handle in a ShardedCounters set.
+ * flush() adds the increments since the last flush to the HltStatistics counters of the same
+ * name and must be called before these are read, i.e. before every publication.
+ */
+class HltCounters {
+public:
+	/**
+	 * Must be called at initialization, before the returned handle is used by any thread
+	 */
+	static HltCounterHandle registerCounter(std::string name);
+
+	static inline void sum(HltCounterHandle handle, uint64_t value) {
+		counters_.add(handle, value);
+	}
+
+	static void flush();
+
+private:
+	static const uint MAX_COUNTERS = 32;
+
+	static ShardedCounters counters_;
+	static std::vector<std::string> names_;
+	static uint64_t flushed_[MAX_COUNTERS];
+	static std::mutex flushMutex_;
+};
+
+} /* namespace na62 */
+
+#endif /* HLTCOUNTERS_H_ */
@@ -0,0 +1,135 @@
+/*
+ * LatencyHistograms.cpp
+ *
+ *  Created on: Oct 17, 2026
+ */
+
+#include "LatencyHistograms.h"
+
+#include <sstream>
+
+#include <options/Logging.h>
+
+#include "../options/MyOptions.h"
+
+namespace na62 {
+
+ShardedCounters LatencyHistograms::counters_(NUMBER_OF_LATENCY_STAGES * COUNTERS_PER_STAGE);
+std::atomic<bool> LatencyHistograms::enabled_(false);
+
+static const char* names[NUMBER_OF_LATENCY_STAGES] = { "L0BuildingTime", "L1ProcessingTime", "L1BuildingTime",
+		"L2ProcessingTime", "SerializationTime", "L1BatchWaitTime" };
+
+void LatencyHistograms::initialize() {
+	setEnabled(MyOptions::GetBool(OPTION_LATENCY_HISTOGRAMS));
+}
+
+void LatencyHistograms::setEnabled(bool enabled) {
+	enabled_ = enabled;
+#ifdef MEASURE_TIME
+	LOG_INFO("Latency histograms " << (enabled ? "enabled" : "disabled"));
+#else
+	LOG_INFO("Latency histograms " << (enabled ? "enabled" : "disabled") << " but no times are measured without MEASURE_TIME");
+#endif
+}
+
+const char* LatencyHistograms::getName(LatencyStage stage) {
+	return names[stage];
+}
+
+uint64_t LatencyHistograms::getLowerBound(uint bin) {
+	if (bin < 2 * SUB_BUCKETS) {
+		return bin;
+	}
+	const uint exponent = bin / SUB_BUCKETS + SUB_BUCKET_BITS - 1;
+	return (uint64_t) (bin % SUB_BUCKETS + SUB_BUCKETS) << (exponent - SUB_BUCKET_BITS);
+}
+
+uint64_t LatencyHistograms::getUpperBound(uint bin) {
+	/*
+	 * The last bin also takes all larger values
+	 */
+	if (bin == NUMBER_OF_BINS - 1) {
+		return getLowerBound(bin);
+	}
+	return getLowerBound(bin + 1) - 1;
+}
+
+uint64_t LatencyHistograms::readBins(LatencyStage stage, uint64_t* bins) {
+	uint64_t entries = 0;
+	for (uint bin = 0; bin != NUMBER_OF_BINS; bin++) {
+		bins[bin] = counters_.get(stage * COUNTERS_PER_STAGE + bin);
+		entries += bins[bin];
+	}
+	return entries;
+}
+
+LatencyHistograms::Summary LatencyHistograms::getSummary(LatencyStage stage) {
+	uint64_t bins[NUMBER_OF_BINS];
+	Summary summary { };
+	summary.count = readBins(stage, bins);
+	if (summary.count == 0) {
+		return summary;
+	}
+	summary.mean = counters_.get(stage * COUNTERS_PER_STAGE + SUM) / summary.count;
+
+	/*
+	 * Entries below which the percentiles are found, rounded up
+	 */
+	const uint64_t p50 = (summary.count * 500 + 999) / 1000;
+	const uint64_t p90 = (summary.count * 900 + 999) / 1000;
+	const uint64_t p99 = (summary.count * 990 + 999) / 1000;
+	const uint64_t p999 = (summary.count * 999 + 999) / 1000;
+
+	uint64_t entries = 0;
+	for (uint bin = 0; bin != NUMBER_OF_BINS; bin++) {
+		if (bins[bin] == 0) {
+			continue;
+		}
+		const uint64_t previous = entries;
+		entries += bins[bin];
+		const uint64_t upperBound = getUpperBound(bin);
+		if (previous < p50 && entries >= p50) {
+			summary.p50 = upperBound;
+		}
+		if (previous < p90 && entries >= p90) {
+			summary.p90 = upperBound;
+		}
+		if (previous < p99 && entries >= p99) {
+			summary.p99 = upperBound;
+		}
+		if (previous < p999 && entries >= p999) {
+			summary.p999 = upperBound;
+		}
+		summary.max = upperBound;
+	}
+	return summary;
+}
+
+std::string LatencyHistograms::serializeHistogram(LatencyStage stage) {
+	uint64_t bins[NUMBER_OF_BINS];
+	readBins(stage, bins);
+
+	std::stringstream stream;
+	for (uint bin = 0; bin != NUMBER_OF_BINS; bin++) {
+		if (bins[bin] != 0) {
+			stream << getLowerBound(bin) << ":" << bins[bin] << ";";
+		}
+	}
+	return stream.str();
+}
+
+std::string LatencyHistograms::serializePercentiles(LatencyStage stage) {
+	const Summary summary = getSummary(stage);
+
+	std::stringstream stream;
+	stream << "count:" << summary.count << ";mean:" << summary.mean << ";p50:" << summary.p50 << ";p90:" << summary.p90
+			<< ";p99:" << summary.p99 << ";p999:" << summary.p999 << ";max:" << summary.max << ";";
+	return stream.str();
+}
+
+void LatencyHistograms::reset() {
+	counters_.reset();
+}
+
+} /* namespace na62 */
@@ -0,0 +1,133 @@
+/*
+ * LatencyHistograms.h
+ *
+ * Distributions of the event building and trigger processing times
+ *
+ *  Created on: Oct 17, 2026
+ */
+
+#ifndef LATENCYHISTOGRAMS_H_
+#define LATENCYHISTOGRAMS_H_
+
+#include <sys/types.h>
+#include <atomic>
+#include <cstdint>
+#include <string>
+
+#include "../utils/ShardedCounters.h"
+
+namespace na62 {
+
+enum LatencyStage : uint {
+	L0_BUILDING_TIME,
+	L1_PROCESSING_TIME,
+	L1_BUILDING_TIME,
+	L2_PROCESSING_TIME,
+	SERIALIZATION_TIME,
+	L1_BATCH_WAIT_TIME,
+	NUMBER_OF_LATENCY_STAGES
+};
+
+/*
+ * One log-linear histogram per stage: values below 32 have their own bin, above that every power of
+ * two is split into 16 bins, so any value is known to within 1/16. The values are taken in the unit
+ * of the Event timers, only L1_BATCH_WAIT_TIME is in microseconds.
+ *
+ * The bins are counters of a ShardedCounters set, so record() only writes to memory of the calling
+ * thread. Readers merge the shards without locking and reset() starts the next burst.
+ */
+class LatencyHistograms {
+public:
+	struct Summary {
+		uint64_t count;
+		uint64_t mean;
+		uint64_t p50;
+		uint64_t p90;
+		uint64_t p99;
+		uint64_t p999;
+		uint64_t max;
+	};
+
+	/**
+	 * Reads whether recording is enabled initially
+	 */
+	static void initialize();
+
+	/**
+	 * May be called at any time, e.g. by the CommandConnector
+	 */
+	static void setEnabled(bool enabled);
+
+	static inline bool isEnabled() {
+		return enabled_.load(std::memory_order_relaxed);
+	}
+
+	static inline void record(LatencyStage stage, uint64_t value) {
+		if (!isEnabled()) {
+			return;
+		}
+		const uint first = stage * COUNTERS_PER_STAGE;
+		counters_.increment(first + getBin(value));
+		counters_.add(first + SUM, value);
+	}
+
+	/**
+	 * Percentiles and max are the upper bounds of the bins they fall into
+	 */
+	static Summary getSummary(LatencyStage stage);
+
+	/*
+	 * "lowerBound:entries;" for every bin with entries
+	 */
+	static std::string serializeHistogram(LatencyStage stage);
+
+	/*
+	 * "count:n;mean:m;p50:x;p90:x;p99:x;p999:x;max:x;"
+	 */
+	static std::string serializePercentiles(LatencyStage stage);
+
+	/**
+	 * Prefix of the statistics published for <stage>, e.g. "L0BuildingTime"
+	 */
+	static const char* getName(LatencyStage stage);
+
+	static void reset();
+
+private:
+	static const uint SUB_BUCKET_BITS = 4;
+	static const uint SUB_BUCKETS = 1 << SUB_BUCKET_BITS;
+	static const uint MAX_VALUE_BITS = 36;
+	static const uint NUMBER_OF_BINS = (MAX_VALUE_BITS - SUB_BUCKET_BITS + 1) * SUB_BUCKETS;
+
+	/*
+	 * Per stage: the bins followed by the sum of all values
+	 */
+	static const uint SUM = NUMBER_OF_BINS;
+	static const uint COUNTERS_PER_STAGE = NUMBER_OF_BINS + 1;
+
+	static inline uint getBin(uint64_t value) {
+		if (value < 2 * SUB_BUCKETS) {
+			return value;
+		}
+		if (value >> MAX_VALUE_BITS) {
+			return NUMBER_OF_BINS - 1;
+		}
+		const uint exponent = 63 - __builtin_clzll(value);
+		return (exponent - SUB_BUCKET_BITS + 1) * SUB_BUCKETS + (value >> (exponent - SUB_BUCKET_BITS)) - SUB_BUCKETS;
+	}
+
+	static uint64_t getLowerBound(uint bin);
+	static uint64_t getUpperBound(uint bin);
+
+	/**
+	 * Reads all bins of <stage> into <bins> and returns the number of entries
+	 */
+	static uint64_t readBins(LatencyStage stage, uint64_t* bins);
+
+	static ShardedCounters counters_;
+	static std::atomic<bool> enabled_;
+};
+
+} /* namespace na62 */
+
+#endif /* LATENCYHISTOGRAMS_H_ */
@@ -32,10 +32,25 @@
 #include <l1/L1TriggerProcessor.h>
 #include <l2/L2TriggerProcessor.h>
 #include "../eventBuilding/L1Builder.h"
+#include "../eventBuilding/L1Processor.h"
+#ifdef USE_SHAREDMEMORY
+#include "../SharedMemory/QueueReceiver.h"
+#endif
 #include "../eventBuilding/L2Builder.h"
+#include "../eventBuilding/EventDispatcher.h"
+#include "../eventBuilding/StorageHandler.h"
 #include "../socket/HandleFrameTask.h"
 #include "../socket/FragmentStore.h"
+#include "../socket/QueueFragmentStore.h"
 #include "../socket/PacketHandler.h"
+#include "../socket/FramePool.h"
+#include "../socket/TaskProcessor.h"
+#include "../socket/OverloadControl.h"
+#include "../socket/MEPPool.h"
+#include "../socket/ChecksumVerifier.h"
+#include "LatencyHistograms.h"
+#include "HltCounters.h"
+#include "../utils/RateLimitedLog.h"
 #include <socket/NetworkHandler.h>
 #include <monitoring/HltStatistics.h>
 
@@ -81,8 +96,20 @@ void MonitorConnector::handleUpdate() {
 	IPCHandler::updateState(currentState_);
 
 	LOG_INFO("Enqueued tasks:\t" << HandleFrameTask::getNumberOfQeuedTasks());
+	LOG_INFO("Task queues:\t" << TaskProcessor::serializeQueueSizes());
+	LOG_INFO("Task lanes:\t" << TaskProcessor::serializeLaneSizes());
+	if (L1Processor::isEnabled()) {
+		LOG_INFO("L1 queue:\t" << L1Processor::getQueueSize());
+	}
+	FragmentStore::evictStaleFrames(false);
 	LOG_INFO(
-			"IPFragments:\t" << FragmentStore::getNumberOfReceivedFragments()<<"/"<<FragmentStore::getNumberOfReassembledFrames() <<"/"<<FragmentStore::getNumberOfUnfinishedFrames());
+			"IPFragments:\t" << FragmentStore::getNumberOfReceivedFragments()<<"/"<<FragmentStore::getNumberOfReassembledFrames() <<"/"<<FragmentStore::getNumberOfUnfinishedFrames()<<"/"<<FragmentStore::getNumberOfDroppedFragments()<<"/"<<FragmentStore::getNumberOfStaleFrames());
+	if (QueueFragmentStore::isEnabled()) {
+		LOG_INFO("IPFragmentsRX:\t" << QueueFragmentStore::getNumberOfReceivedFragments() << "/" << QueueFragmentStore::getNumberOfReassembledFrames()
+				<< "/" << QueueFragmentStore::getNumberOfUnfinishedFrames() << "/" << QueueFragmentStore::getNumberOfDroppedFragments());
+	}
+	LOG_INFO("Overload:\t" << OverloadControl::getLevel() << "/" << OverloadControl::getQueuedFrames() << "/" << OverloadControl::getQueuedBytes());
+	LOG_INFO("FramePool:\t" << FramePool::getNumberOfBuffersInUse() << "/" << FramePool::getHighWatermark() << "/" << FramePool::getNumberOfExhaustions());
 	LOG_INFO("BurstID:\t" << BurstIdHandler::getCurrentBurstId());
 	LOG_INFO("State:\t" << currentState_);
 
@@ -95,13 +122,34 @@ void MonitorConnector::handleUpdate() {
 
 	IPCHandler::sendStatistics("L1MRPsSent", std::to_string(l1::L1DistributionHandler::GetL1MRPsSent()));
 	IPCHandler::sendStatistics("L1TriggersSent", std::to_string(l1::L1DistributionHandler::GetL1TriggersSent()));
+	IPCHandler::sendStatistics("L1Batches", std::to_string(L1Builder::GetL1Batches()));
+	IPCHandler::sendStatistics("L1BatchedEvents", std::to_string(L1Builder::GetL1BatchedEvents()));
+#ifdef USE_SHAREDMEMORY
+	IPCHandler::sendStatistics("L1RemoteEvents", std::to_string(L1Builder::GetL1RemoteEvents()));
+	IPCHandler::sendStatistics("L1LocalEvents", std::to_string(L1Builder::GetL1LocalEvents()));
+	IPCHandler::sendStatistics("L1LocalFallbackEvents", std::to_string(L1Builder::GetL1LocalFallbackEvents()));
+	IPCHandler::sendStatistics("L1BlindlyAcceptedEvents", std::to_string(L1Builder::GetL1BlindlyAcceptedEvents()));
+	IPCHandler::sendStatistics("L1TriggerQueueFill", std::to_string(L1Builder::GetTriggerQueueFill()));
+	if (QueueReceiver::isResponseRingEnabled()) {
+		IPCHandler::sendStatistics("TriggerResponseRingDepth", QueueReceiver::serializeResponseRingSizes());
+		IPCHandler::sendStatistics("QueueReceiverParks", std::to_string(QueueReceiver::getNumberOfParks()));
+	}
+#endif
 	IPCHandler::sendStatistics("PF_BytesReceived", std::to_string(NetworkHandler::GetBytesReceived()));
 	IPCHandler::sendStatistics("PF_PacksReceived", std::to_string(NetworkHandler::GetFramesReceived()));
 	IPCHandler::sendStatistics("PF_PacksDropped", std::to_string(NetworkHandler::GetFramesDropped()));
+	IPCHandler::sendStatistics("FramePoolExhausted", std::to_string(FramePool::getNumberOfExhaustions()));
+	IPCHandler::sendStatistics("FramePoolHighWatermark", std::to_string(FramePool::getHighWatermark()));
+	IPCHandler::sendStatistics("MEPPoolExhausted", std::to_string(MEPPool::getNumberOfExhaustions()));
+	IPCHandler::sendStatistics("MEPPoolInUse", std::to_string(MEPPool::getNumberOfMEPsInUse()));
+	IPCHandler::sendStatistics("VirtualSourcePoolExhausted", std::to_string(HandleFrameTask::getNumberOfVirtualSourcePoolExhaustions()));
+
+	RateLimitedLog::flush();
 
 	/*
 	 * L1-L2 statistics
 	 */
+	HltCounters::flush();
 	for (auto& key : HltStatistics::extractKeys()) {
 		IPCHandler::sendStatistics(key, std::to_string(HltStatistics::getRollingCounter(key)));
 	}
@@ -159,6 +207,42 @@ void MonitorConnector::handleUpdate() {
 	}
 	IPCHandler::sendStatistics("DetectorData", statistics.str());
 
+	IPCHandler::sendStatistics("PacketHandlerBatchSize", PacketHandler::serializeBatchSizeHistogram());
+	IPCHandler::sendStatistics("PacketHandlerBatchAge", PacketHandler::serializeBatchAgeHistogram());
+	IPCHandler::sendStatistics("TaskQueueDepth", TaskProcessor::serializeQueueSizes());
+	IPCHandler::sendStatistics("TaskQueueStolen", TaskProcessor::serializeStolenTasks());
+	IPCHandler::sendStatistics("TaskLaneDepth", TaskProcessor::serializeLaneSizes());
+	IPCHandler::sendStatistics("TaskLaneWait", TaskProcessor::serializeLaneWaitTimes());
+	IPCHandler::sendStatistics("TaskProcessorOccupancy", TaskProcessor::serializeOccupancy());
+	if (L1Processor::isEnabled()) {
+		IPCHandler::sendStatistics("L1QueueDepth", std::to_string(L1Processor::getQueueSize()));
+		IPCHandler::sendStatistics("L1ProcessorOccupancy", L1Processor::serializeOccupancy());
+		IPCHandler::sendStatistics("L1ProcessorParks", std::to_string(L1Processor::getNumberOfParks()));
+	}
+
+	OverloadControl::update();
+	IPCHandler::sendStatistics("OverloadLevel", std::to_string(OverloadControl::getLevel()));
+	IPCHandler::sendStatistics("OverloadQueuedFrames", std::to_string(OverloadControl::getQueuedFrames()));
+	IPCHandler::sendStatistics("OverloadQueuedBytes", std::to_string(OverloadControl::getQueuedBytes()));
+	IPCHandler::sendStatistics("OverloadDroppedFrames", std::to_string(OverloadControl::getNumberOfDroppedFrames()));
+	IPCHandler::sendStatistics("OverloadDroppedL0MEPs", std::to_string(OverloadControl::getNumberOfDroppedL0MEPs()));
+	IPCHandler::sendStatistics("IPFragmentsUnfinished", std::to_string(FragmentStore::getNumberOfUnfinishedFrames() + QueueFragmentStore::getNumberOfUnfinishedFrames()));
+	IPCHandler::sendStatistics("IPFragmentsStaleFrames", std::to_string(FragmentStore::getNumberOfStaleFrames()));
+	IPCHandler::sendStatistics("IPFragmentsStaleFragments", std::to_string(FragmentStore::getNumberOfStaleFragments()));
+	IPCHandler::sendStatistics("IPFragmentsStaleBySourceIP", FragmentStore::serializeStaleFragmentsBySourceIP());
+
+	IPCHandler::sendStatistics("ChecksumErrors", std::to_string(ChecksumVerifier::getNumberOfFailures()));
+	IPCHandler::sendStatistics("ChecksumErrorsBySourceIP", ChecksumVerifier::serializeFailuresBySourceIP());
+	IPCHandler::sendStatistics("ChecksumErrorsByDetector", ChecksumVerifier::serializeFailuresByDetector());
+	IPCHandler::sendStatistics("TaskProcessorParks", std::to_string(TaskProcessor::getNumberOfParks()));
+	IPCHandler::sendStatistics("TaskProcessorWakeups", std::to_string(TaskProcessor::getNumberOfWakeups()));
+	IPCHandler::sendStatistics("StorageHandlerParks", std::to_string(StorageHandler::getWaiter().getNumberOfParks()));
+	IPCHandler::sendStatistics("StorageHandlerWakeups", std::to_string(StorageHandler::getWaiter().getNumberOfWakeups()));
+	if (EventDispatcher::isSharded()) {
+		IPCHandler::sendStatistics("EventShardInboxDepth", EventDispatcher::serializeInboxSizes());
+		IPCHandler::sendStatistics("EventShardForwarded", EventDispatcher::serializeForwardedFragments());
+	}
+
 	for (auto& key : HltStatistics::extractDimensionalKeys()) {
 		IPCHandler::sendStatistics(key, HltStatistics::serializeDimensionalCounter(key));
 	}
@@ -189,96 +273,20 @@ void MonitorConnector::handleUpdate() {
 	IPCHandler::sendStatistics("L2TriggerData", L2Stats.str());
 
 	/*
-	 * Building Time L0-L1 statistics
-	 *
+	 * Building and processing times since the start of the burst
 	 */
-	uint64_t L0BuildTimeMean = 0;
-	uint64_t L1BuildTimeMean = 0;
-	uint64_t L1InputEventsPerBurst = HltStatistics::getCounter("L1InputEvents");
-	uint64_t L2InputEventsPerBurst = HltStatistics::getCounter("L2InputEvents");
-
-
-	if (L1Builder::GetL0BuildingTimeCumulative()) {
-		if (L1InputEventsPerBurst) {
-			L0BuildTimeMean = L1Builder::GetL0BuildingTimeCumulative() / L1InputEventsPerBurst;
+	if (LatencyHistograms::isEnabled()) {
+		for (uint stageNum = 0; stageNum != NUMBER_OF_LATENCY_STAGES; stageNum++) {
+			const LatencyStage stage = (LatencyStage) stageNum;
+			const LatencyHistograms::Summary summary = LatencyHistograms::getSummary(stage);
+			const std::string name = LatencyHistograms::getName(stage);
+
+			//singlelongServices
+			IPCHandler::sendStatistics(name + "Mean", std::to_string(summary.mean));
+			IPCHandler::sendStatistics(name + "Max", std::to_string(summary.max));
+			IPCHandler::sendStatistics(name + "Percentiles", LatencyHistograms::serializePercentiles(stage));
 		}
 	}
-	if (L2Builder::GetL1BuildingTimeCumulative()) {
-		if (L2InputEventsPerBurst) {
-			L1BuildTimeMean = L2Builder::GetL1BuildingTimeCumulative() / L2InputEventsPerBurst;
-		}
-	}
-	uint64_t L0BuildTimeMax = L1Builder::GetL0BuildingTimeMax();
-	uint64_t L1BuildTimeMax = L2Builder::GetL1BuildingTimeMax();
-
-	//singlelongServices
-	IPCHandler::sendStatistics("L0BuildingTimeMean", std::to_string(L0BuildTimeMean));
-	IPCHandler::sendStatistics("L1BuildingTimeMean", std::to_string(L1BuildTimeMean));
-	IPCHandler::sendStatistics("L0BuildingTimeMax", std::to_string(L0BuildTimeMax));
-	IPCHandler::sendStatistics("L1BuildingTimeMax", std::to_string(L1BuildTimeMax));
-
-	/*
-	 * Timing L1-L2 statistics
-	 *
-	 */
-	uint64_t L1ProcTimeMean = 0;
-	uint64_t L2ProcTimeMean = 0;
-
-	if (L1Builder::GetL1ProcessingTimeCumulative()) {
-		if (L1InputEventsPerBurst) {
-			L1ProcTimeMean = L1Builder::GetL1ProcessingTimeCumulative() / L1InputEventsPerBurst;
-		}
-	}
-	if (L2Builder::GetL2ProcessingTimeCumulative()) {
-		if (L2InputEventsPerBurst) {
-			L2ProcTimeMean = L2Builder::GetL2ProcessingTimeCumulative() / L2InputEventsPerBurst;
-		}
-	}
-
-	uint64_t L1ProcTimeMax = L1Builder::GetL1ProcessingTimeMax();
-	uint64_t L2ProcTimeMax = L2Builder::GetL2ProcessingTimeMax();
-
-	//singlelongServices
-	IPCHandler::sendStatistics("L1ProcessingTimeMean", std::to_string(L1ProcTimeMean));
-	IPCHandler::sendStatistics("L2ProcessingTimeMean", std::to_string(L2ProcTimeMean));
-	IPCHandler::sendStatistics("L1ProcessingTimeMax", std::to_string(L1ProcTimeMax));
-	IPCHandler::sendStatistics("L2ProcessingTimeMax", std::to_string(L2ProcTimeMax));
-
-//	/*
-//	 * Timing statistics for histograms
-//	 */
-//	std::stringstream L0BuildTimeVsEvtNumStats;
-//	std::stringstream L1BuildTimeVsEvtNumStats;
-//	std::stringstream L1ProcTimeVsEvtNumStats;
-//	std::stringstream L2ProcTimeVsEvtNumStats;
-//
-//	for (int timeId = 0x00; timeId < 0x64 + 1; timeId++) {
-//		for (int tsId = 0x00; tsId < 0x64 + 1; tsId++) {
-//
-//			uint64_t L0BuildTimeVsEvtNum = L1Builder::GetL0BuidingTimeVsEvtNumber()[timeId][tsId];
-//			uint64_t L1BuildTimeVsEvtNum = L2Builder::GetL1BuidingTimeVsEvtNumber()[timeId][tsId];
-//			uint64_t L1ProcTimeVsEvtNum = L1Builder::GetL1ProcessingTimeVsEvtNumber()[timeId][tsId];
-//			uint64_t L2ProcTimeVsEvtNum = L2Builder::GetL2ProcessingTimeVsEvtNumber()[timeId][tsId];
-//
-//			if (L0BuildTimeVsEvtNum > 0) {
-//				L0BuildTimeVsEvtNumStats << timeId << "," << tsId << "," << L0BuildTimeVsEvtNum << ";";
-//			}
-//			if (L1BuildTimeVsEvtNum > 0) {
-//				L1BuildTimeVsEvtNumStats << timeId << "," << tsId << "," << L1BuildTimeVsEvtNum << ";";
-//			}
-//			if (L1ProcTimeVsEvtNum > 0) {
-//				L1ProcTimeVsEvtNumStats << timeId << "," << tsId << "," << L1ProcTimeVsEvtNum << ";";
-//			}
-//			if (L2ProcTimeVsEvtNum > 0) {
-//				L2ProcTimeVsEvtNumStats << timeId << "," << tsId << "," << L2ProcTimeVsEvtNum << ";";
-//			}
-//		}
-//	}
-//
-//	IPCHandler::sendStatistics("L0BuildingTimeVsEvtNumber", L0BuildTimeVsEvtNumStats.str());
-//	IPCHandler::sendStatistics("L1BuildingTimeVsEvtNumber", L1BuildTimeVsEvtNumStats.str());
-//	IPCHandler::sendStatistics("L1ProcessingTimeVsEvtNumber", L1ProcTimeVsEvtNumStats.str());
-//	IPCHandler::sendStatistics("L2ProcessingTimeVsEvtNumber", L2ProcTimeVsEvtNumStats.str());
 }
 
 }
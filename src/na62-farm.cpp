@@ -33,7 +33,9 @@
 #include <storage/SmartEventSerializer.h>
 
 #include "eventBuilding/L1Builder.h"
+#include "eventBuilding/L1Processor.h"
 #include "eventBuilding/L2Builder.h"
+#include "eventBuilding/EventDispatcher.h"
 #include "eventBuilding/StorageHandler.h"
 #include "monitoring/MonitorConnector.h"
 #include "monitoring/HltStatistics.h"
@@ -42,7 +44,17 @@
 #include "socket/TaskProcessor.h"
 #include "socket/ZMQHandler.h"
 #include "socket/HandleFrameTask.h"
+#include "socket/FragmentStore.h"
+#include "socket/QueueFragmentStore.h"
+#include "socket/FramePool.h"
+#include "socket/MEPPool.h"
+#include "socket/OverloadControl.h"
+#include "socket/ChecksumVerifier.h"
 #include "monitoring/CommandConnector.h"
+#include "monitoring/HltCounters.h"
+#include "monitoring/LatencyHistograms.h"
+#include "utils/ThreadPlacement.h"
+#include "utils/RateLimitedLog.h"
 
 #ifdef USE_SHAREDMEMORY
 #include "SharedMemory/SharedMemoryManager.h"
@@ -57,6 +69,8 @@ using namespace na62;
 
 std::vector<PacketHandler*> packetHandlers;
 std::vector<TaskProcessor*> taskProcessors;
+std::vector<L1Processor*> l1Processors;
+HltCounterHandle L1CorruptedHeader;
 
 class FarmShutdown: public Shutdown {
 private:
@@ -75,11 +89,21 @@ private:
 			ZMQHandler::Stop();
 			AExecutable::InterruptAll();
 
+#ifdef USE_SHAREDMEMORY
+			LOG_INFO("Removing the trigger response ring");
+			QueueReceiver::shutDown();
+#endif
+
 			LOG_INFO("Stopping packet handlers");
 			for (auto& handler : packetHandlers) {
 				handler->stopRunning();
 			}
 
+			LOG_INFO("Stopping L1 processors");
+			for (auto& processor : l1Processors) {
+				processor->stop();
+			}
+
 			LOG_INFO("Stopping storage handler");
 			StorageHandler::onShutDown();
 
@@ -145,6 +169,28 @@ private:
 //	}
 //}
 
+/*
+ * Events waiting for the L1 trigger are unfinished: the cleanup of the burst would free them while they
+ * are still referenced by a TaskProcessor or an L1Processor. Fragments forwarded to the TaskProcessor owning
+ * their event are dropped while the burst is flushed, but one being built may still complete its event
+ */
+void waitForPendingL1() {
+	for (uint polls = 1;; polls++) {
+		bool pending = false;
+		for (auto& processor : taskProcessors) {
+			pending |= processor->hasL1Batch() || EventDispatcher::hasInboxWork(processor);
+		}
+		pending |= L1Processor::getQueueSize() != 0;
+		if (!pending) {
+			return;
+		}
+		if (polls % 10000 == 0) {
+			LOG_ERROR("type = EOB : Still waiting for events to be processed by L1 before cleaning up the burst");
+		}
+		usleep(100);
+	}
+}
+
 void onBurstFinished() {
 	static std::atomic<uint> incomplete_events, incomplete_events_with_l1_request_sent;
 	incomplete_events = 0;
@@ -169,9 +215,14 @@ void onBurstFinished() {
 			//Don't think that this can happen..
 			LOG_ERROR("Some trigger results are still waiting to send L1 Request!!!!");
 	}
+	if(QueueReceiver::getNumberOfQueuedResponses() != 0) {
+			LOG_ERROR((int) QueueReceiver::getNumberOfQueuedResponses() << " trigger results are still waiting in the response ring at EOB!!!!");
+	}
 #endif
 
 
+	waitForPendingL1();
+
 	// Do it with parallel_for using tbb if tcmalloc is linked
 	tbb::parallel_for(
 			tbb::blocked_range<uint_fast32_t>(0,
@@ -201,7 +252,7 @@ void onBurstFinished() {
 						event->updateMissingEventsStats();
 						if (event->isMepHeaderCorrupted()) {
 							//Will be written on the L1 EOB packet
-							HltStatistics::sumCounter("L1CorruptedHeader", 1);
+							HltCounters::sum(L1CorruptedHeader, 1);
 						}
 						EventPool::freeEvent(event);
 					}
@@ -227,70 +278,21 @@ void onBurstFinished() {
 
 
 
-#ifdef MEASURE_TIME
-	//Resetting time graphs
 	/*
-	 * Timing statistics for histograms
+	 * Building and processing time distributions of the burst
 	 */
-	std::stringstream L0BuildTimeVsEvtNumStats;
-	std::stringstream L1BuildTimeVsEvtNumStats;
-	std::stringstream L1ProcTimeVsEvtNumStats;
-	std::stringstream L2ProcTimeVsEvtNumStats;
-	std::stringstream SerializationTimeVsEvtNumStats;
-
-	for (int timeId = 0x00; timeId < 0x64 + 1; ++timeId) {
-		for (int tsId = 0x00; tsId < 0x64 + 1; ++tsId) {
-
-			uint64_t L0BuildTimeVsEvtNum = L1Builder::GetL0BuidingTimeVsEvtNumber()[timeId][tsId];
-			uint64_t L1BuildTimeVsEvtNum = L2Builder::GetL1BuidingTimeVsEvtNumber()[timeId][tsId];
-			uint64_t L1ProcTimeVsEvtNum = L1Builder::GetL1ProcessingTimeVsEvtNumber()[timeId][tsId];
-			uint64_t L2ProcTimeVsEvtNum = L2Builder::GetL2ProcessingTimeVsEvtNumber()[timeId][tsId];
-			uint64_t SerializationTimeVsEvtNum = L2Builder::GetL2ProcessingTimeVsEvtNumber()[timeId][tsId];
-
-			if (L0BuildTimeVsEvtNum > 0) {
-				L0BuildTimeVsEvtNumStats << timeId << "," << tsId << "," << L0BuildTimeVsEvtNum << ";";
-			}
-			if (L1BuildTimeVsEvtNum > 0) {
-				L1BuildTimeVsEvtNumStats << timeId << "," << tsId << "," << L1BuildTimeVsEvtNum << ";";
-			}
-			if (L1ProcTimeVsEvtNum > 0) {
-				L1ProcTimeVsEvtNumStats << timeId << "," << tsId << "," << L1ProcTimeVsEvtNum << ";";
-			}
-			if (L2ProcTimeVsEvtNum > 0) {
-				L2ProcTimeVsEvtNumStats << timeId << "," << tsId << "," << L2ProcTimeVsEvtNum << ";";
-			}
-			if (SerializationTimeVsEvtNum > 0) {
-				SerializationTimeVsEvtNumStats << timeId << "," << tsId << "," << L2ProcTimeVsEvtNum << ";";
-			}
+	if (LatencyHistograms::isEnabled()) {
+		for (uint stageNum = 0; stageNum != NUMBER_OF_LATENCY_STAGES; stageNum++) {
+			const LatencyStage stage = (LatencyStage) stageNum;
+			const std::string name = LatencyHistograms::getName(stage);
+			IPCHandler::sendStatistics(name + "Histogram", LatencyHistograms::serializeHistogram(stage));
+			IPCHandler::sendStatistics(name + "Percentiles", LatencyHistograms::serializePercentiles(stage));
 		}
 	}
-
-	IPCHandler::sendStatistics("L0BuildingTimeVsEvtNumber", L0BuildTimeVsEvtNumStats.str());
-	IPCHandler::sendStatistics("L1BuildingTimeVsEvtNumber", L1BuildTimeVsEvtNumStats.str());
-	IPCHandler::sendStatistics("L1ProcessingTimeVsEvtNumber", L1ProcTimeVsEvtNumStats.str());
-	IPCHandler::sendStatistics("L2ProcessingTimeVsEvtNumber", L2ProcTimeVsEvtNumStats.str());
-	IPCHandler::sendStatistics("SerializationTimeVsEvtNumber", SerializationTimeVsEvtNumStats.str());
-
-	L1Builder::ResetL0BuidingTimeVsEvtNumber();
-	L2Builder::ResetL1BuidingTimeVsEvtNumber();
-	L1Builder::ResetL1ProcessingTimeVsEvtNumber();
-	L2Builder::ResetL2ProcessingTimeVsEvtNumber();
-	L2Builder::ResetSerializationTimeVsEvtNumber();
-
-
-
-	L1Builder::ResetL0BuildingTimeCumulative();
-	L1Builder::ResetL0BuildingTimeMax();
-	L1Builder::ResetL1ProcessingTimeCumulative();
-	L1Builder::ResetL1ProcessingTimeMax();
-
-	L2Builder::ResetL1BuildingTimeCumulative();
-	L2Builder::ResetL1BuildingTimeMax();
-	L2Builder::ResetL2ProcessingTimeCumulative();
-	L2Builder::ResetL2ProcessingTimeMax();
-#endif
+	LatencyHistograms::reset();
 
 	//Updating PerBurstCounters
+	HltCounters::flush();
 	for (auto& key : HltStatistics::extractKeys()) {
 		IPCHandler::sendStatistics(key + "PerBurst", std::to_string(HltStatistics::getRollingCounter(key)));
 	}
@@ -306,6 +308,9 @@ void onBurstFinished() {
 	//Resetting ALL HLT statistics
 	HltStatistics::resetCounters();
 	HandleFrameTask::resetCounters();
+	PacketHandler::resetBatchHistograms();
+	OverloadControl::onBurstFinished();
+	FragmentStore::evictStaleFrames(true);
 	Event::resetCounters();
 
 	//Memory monitor
@@ -347,6 +352,11 @@ int main(int argc, char* argv[]) {
 	TriggerOptions::Load(argc, argv);
 	MyOptions::Load(argc, argv);
 
+	/*
+	 * All threads started from now on without explicit CPU (ZMQ IO threads included) run on the housekeeping cores
+	 */
+	ThreadPlacement::initialize(Options::GetString(OPTION_ETH_DEVICE_NAME), Options::GetInt(OPTION_HOUSEKEEPING_CORES));
+	ThreadPlacement::pinToHousekeeping();
 
 	try {
 		ZMQHandler::Initialize(Options::GetInt(OPTION_ZMQ_IO_THREADS));
@@ -379,6 +389,9 @@ int main(int argc, char* argv[]) {
 	}
 
 	HltStatistics::initialize(logicalNodeID);
+	RateLimitedLog::initialize();
+	LatencyHistograms::initialize();
+	L1CorruptedHeader = HltCounters::registerCounter("L1CorruptedHeader");
 
 	/*
 	 * initialize NIC handler and start gratuitous ARP request sending thread
@@ -397,6 +410,7 @@ int main(int argc, char* argv[]) {
 			&onBurstFinished);
 
 	HandleFrameTask::initialize();
+	FragmentStore::initialize();
 
 	SmartEventSerializer::initialize();
 	try {
@@ -415,15 +429,17 @@ int main(int argc, char* argv[]) {
 	//Initialize the shared memory
 	SharedMemoryManager::initialize();
 	//Starting queue Receiver for processed L1
-	QueueReceiver receiver;
-	receiver.startThread("QueueReceiver");
+	QueueReceiver::initialize();
+	for (uint i = 0; i != QueueReceiver::getNumberOfReceivers(); i++) {
+		QueueReceiver* receiver = new QueueReceiver(i);
+		receiver->startThread(i, "QueueReceiver");
+	}
 	//PoolParser parser;
 	//parser.startThread("PoolParser");
 #endif
 
 
 	L1Builder::initialize();
-	L2Builder::initialize();
 
 	Event::initialize(MyOptions::GetBool(OPTION_PRINT_MISSING_SOURCES));
 
@@ -483,27 +499,48 @@ int main(int argc, char* argv[]) {
 	unsigned int numberOfPacketHandler = NetworkHandler::GetNumberOfQueues();
 	LOG_INFO("Starting " << numberOfPacketHandler << " PacketHandler threads");
 
+	FramePool::initialize(numberOfPacketHandler);
+	QueueFragmentStore::initialize(numberOfPacketHandler);
+	PacketHandler::initialize(numberOfPacketHandler);
+	TaskProcessor::initialize(numberOfPacketHandler);
+	OverloadControl::initialize();
+	ChecksumVerifier::initialize();
+
+	L1Processor::initialize();
+	ThreadPlacement::placeWorkers(numberOfPacketHandler, L1Processor::getNumberOfProcessors());
+	ThreadPlacement::printPlacement();
+	TaskProcessor::assignHomeQueues(ThreadPlacement::getTaskProcessorCPUs().size());
+
 	for (unsigned int i = 0; i < numberOfPacketHandler; i++) {
 		PacketHandler* handler = new PacketHandler(i);
 		packetHandlers.push_back(handler);
 
-		uint coresPerSocket = std::thread::hardware_concurrency()
-				/ 2/*hyperthreading*/;
-		uint cpuMask = i % 2 == 0 ? i / 2 : coresPerSocket + i / 2;
-		handler->startThread(i, "PacketHandler", cpuMask, 25,
+		handler->startThread(i, "PacketHandler", ThreadPlacement::getPacketHandlerCPU(i), 25,
 				MyOptions::GetInt(OPTION_PH_SCHEDULER));
 
 	}
 
-	//for (unsigned int i = 0; i < 4; i++) {
-	for (unsigned int i = 0;
-			i < std::thread::hardware_concurrency() - numberOfPacketHandler;
-			i++) {
-		LOG_INFO("Starting TaskProcessor no: " << i);
+	const std::vector<int>& taskProcessorCPUs = ThreadPlacement::getTaskProcessorCPUs();
+	unsigned int numberOfTaskProcessors = taskProcessorCPUs.size();
+	EventDispatcher::initialize(numberOfTaskProcessors);
+	HandleFrameTask::initializeVirtualSources(numberOfTaskProcessors);
+	MEPPool::initialize(numberOfTaskProcessors);
+	TaskProcessor::initializeOccupancy(numberOfTaskProcessors);
+
+	for (unsigned int i = 0; i < numberOfTaskProcessors; i++) {
+		LOG_INFO("Starting TaskProcessor no: " << i << " on CPU " << taskProcessorCPUs[i]);
 		TaskProcessor* tp = new TaskProcessor(i);
 		taskProcessors.push_back(tp);
-		tp->startThread(i, "TaskProcessor");
+		tp->startThread(i, "TaskProcessor", taskProcessorCPUs[i]);
+
+	}
 
+	const std::vector<int>& l1ProcessorCPUs = ThreadPlacement::getL1ProcessorCPUs();
+	for (unsigned int i = 0; i < l1ProcessorCPUs.size(); i++) {
+		LOG_INFO("Starting L1Processor no: " << i << " on CPU " << l1ProcessorCPUs[i]);
+		L1Processor* l1p = new L1Processor(i);
+		l1Processors.push_back(l1p);
+		l1p->startThread(i, "L1Processor", l1ProcessorCPUs[i]);
 	}
 
 	CommandConnector c;
@@ -64,6 +64,42 @@
 #define OPTION_POLLING_SLEEP_MICROS (char*)"pollingSleepMicros"
 #define OPTION_MAX_FRAME_AGGREGATION (char*)"maxFramesAggregation"
 #define OPTION_MAX_AGGREGATION_TIME (char*)"maxAggregationTime"
+#define OPTION_MAX_AGGREGATION_BYTES (char*)"maxAggregationBytes"
+#define OPTION_TP_IDLE_SPINS (char*)"taskProcessorIdleSpins"
+#define OPTION_TP_IDLE_YIELDS (char*)"taskProcessorIdleYields"
+#define OPTION_SH_IDLE_SPINS (char*)"storageHandlerIdleSpins"
+#define OPTION_SH_IDLE_YIELDS (char*)"storageHandlerIdleYields"
+#define OPTION_IDLE_PARK_TIMEOUT (char*)"idleParkTimeoutMicros"
+#define OPTION_SHARDED_EVENT_BUILDING (char*)"shardedEventBuilding"
+#define OPTION_EVENT_SHARD_WIDTH (char*)"eventShardWidth"
+#define OPTION_TASK_INITIAL_CAPACITY (char*)"taskInitialCapacity"
+#define OPTION_FRAME_POOL_SIZE (char*)"framePoolSize"
+#define OPTION_FRAME_POOL_HUGE_PAGES (char*)"framePoolHugePages"
+#define OPTION_VIRTUAL_SOURCE_POOL_SIZE (char*)"virtualSourcePoolSize"
+#define OPTION_MEP_POOL_SIZE (char*)"mepPoolSize"
+#define OPTION_BATCH_PRE_PASS (char*)"batchPrePass"
+#define OPTION_CHECKSUM_VERIFICATION (char*)"checksumVerification"
+#define OPTION_LOG_EXEMPLARS (char*)"logExemplars"
+#define OPTION_FRAGMENT_TABLE_SIZE (char*)"fragmentTableSize"
+#define OPTION_REASSEMBLE_IN_PACKET_HANDLER (char*)"reassembleInPacketHandler"
+#define OPTION_FRAGMENT_TIMEOUT (char*)"fragmentTimeout"
+#define OPTION_LATENCY_HISTOGRAMS (char*)"latencyHistograms"
+#define OPTION_HOUSEKEEPING_CORES (char*)"housekeepingCores"
+#define OPTION_CREAM_LANE_WEIGHT (char*)"creamLaneWeight"
+#define OPTION_OVERLOAD_LOW_WATERMARK_FRAMES (char*)"overloadLowWatermarkFrames"
+#define OPTION_OVERLOAD_HIGH_WATERMARK_FRAMES (char*)"overloadHighWatermarkFrames"
+#define OPTION_OVERLOAD_LOW_WATERMARK_MB (char*)"overloadLowWatermarkMB"
+#define OPTION_OVERLOAD_HIGH_WATERMARK_MB (char*)"overloadHighWatermarkMB"
+#define OPTION_L1_BATCH_SIZE (char*)"l1BatchSize"
+#define OPTION_L1_BATCH_TIMEOUT (char*)"l1BatchTimeout"
+#define OPTION_L1_PROCESSORS (char*)"l1Processors"
+#define OPTION_L1_LOCAL_FRACTION (char*)"l1LocalFraction"
+#define OPTION_L1_LOCAL_QUEUE_THRESHOLD (char*)"l1LocalQueueThreshold"
+#define OPTION_L1_LOCAL_FALLBACK (char*)"l1LocalFallback"
+#define OPTION_TRIGGER_RESPONSE_RING (char*)"triggerResponseRing"
+#define OPTION_TRIGGER_RESPONSE_RECEIVERS (char*)"triggerResponseReceivers"
+#define OPTION_TRIGGER_RESPONSE_RING_SIZE (char*)"triggerResponseRingSize"
+#define OPTION_OVERLOAD_EVENT_NUMBER_MARGIN (char*)"overloadEventNumberMargin"
 
 /*
  * EOB
@@ -196,6 +232,9 @@ public:
 		(OPTION_PH_SCHEDULER, po::value<int>()->default_value(2),
 				"Process scheduling policy to be used for the PacketHandler threads. 1: FIFO, 2: RR")
 
+		(OPTION_HOUSEKEEPING_CORES, po::value<int>()->default_value(2),
+				"Number of physical cores, on the NUMA node farthest away from the NIC, reserved for the StorageHandler, BurstHandler, L1DistributionHandler, monitoring and ZMQ IO threads. Set to 0 to let them run anywhere")
+
 		(OPTION_ACTIVE_POLLING, po::value<int>()->default_value(1),
 				"Use active polling (high CPU usage, might be faster depending on the number of pf_ring queues)")
 
@@ -209,7 +248,112 @@ public:
 				"Maximum number of frames aggregated before spawning a task to process them")
 
 		(OPTION_MAX_AGGREGATION_TIME, po::value<int>()->default_value(100000),
-				"Maximum time for one frame aggregation period before spawning a new task in microseconds")
+				"Maximum time in microseconds between the first frame of a task and spawning it. Set to 0 to disable the time limit")
+
+		(OPTION_MAX_AGGREGATION_BYTES, po::value<int>()->default_value(0),
+				"Maximum number of bytes aggregated before spawning a task to process them. Set to 0 to disable the byte limit")
+
+		(OPTION_CREAM_LANE_WEIGHT, po::value<int>()->default_value(4),
+				"Number of CREAM frame tasks processed in a row before one L0 frame task is processed if both are queued. Set to 0 to queue all frames in arrival order")
+
+		(OPTION_OVERLOAD_LOW_WATERMARK_FRAMES, po::value<int>()->default_value(1000000),
+				"Number of queued frames above which all frames but ARP, L0 and CREAM data are dropped. Set to 0 to disable")
+
+		(OPTION_OVERLOAD_HIGH_WATERMARK_FRAMES, po::value<int>()->default_value(2000000),
+				"Number of queued frames above which additionally the L0 MEPs of events not started yet are dropped. Set to 0 to disable")
+
+		(OPTION_OVERLOAD_LOW_WATERMARK_MB, po::value<int>()->default_value(4096),
+				"Number of queued MB above which all frames but ARP, L0 and CREAM data are dropped. Set to 0 to disable")
+
+		(OPTION_OVERLOAD_HIGH_WATERMARK_MB, po::value<int>()->default_value(8192),
+				"Number of queued MB above which additionally the L0 MEPs of events not started yet are dropped. Set to 0 to disable")
+
+		(OPTION_L1_BATCH_SIZE, po::value<int>()->default_value(1),
+				"Number of completed events collected by a TaskProcessor before the L1 trigger is run over all of them. Set to 1 to process every event as soon as it is complete")
+
+		(OPTION_L1_BATCH_TIMEOUT, po::value<int>()->default_value(100),
+				"Maximum time in microseconds a completed event waits for its L1 batch to be full. Batches are processed anyway as soon as the TaskProcessor runs out of work")
+
+		(OPTION_L1_PROCESSORS, po::value<int>()->default_value(0),
+				"Number of threads running the L1 trigger on the events built by the TaskProcessors. They get their own CPUs, taken from the TaskProcessors farthest away from the NIC. Set to 0 to run the L1 trigger in the TaskProcessors")
+
+		(OPTION_L1_LOCAL_FRACTION, po::value<int>()->default_value(0),
+				"Only with shared memory: percentage of the events processed by L1 within this process instead of the external trigger processes")
+
+		(OPTION_L1_LOCAL_QUEUE_THRESHOLD, po::value<int>()->default_value(80),
+				"Only with shared memory: filling of the trigger queue in percent above which the share of events processed locally rises linearly up to all events for a full queue. Set to 100 to disable")
+
+		(OPTION_L1_LOCAL_FALLBACK, po::value<bool>()->default_value(true),
+				"Only with shared memory: process events locally if they can't be stored in the shared memory. Otherwise they are accepted by L1 with trigger word 0x20")
+
+		(OPTION_TRIGGER_RESPONSE_RING, po::value<bool>()->default_value(false),
+				"Only with shared memory: receive the L1 decisions of the trigger processes from the lock-free ring /na62-trigger-responses instead of the message queue. The trigger processes must push to the ring as well")
+
+		(OPTION_TRIGGER_RESPONSE_RECEIVERS, po::value<int>()->default_value(1),
+				"Only with triggerResponseRing: number of QueueReceiver threads. The trigger processes push every response to the ring of receiver eventNumber % triggerResponseReceivers")
+
+		(OPTION_TRIGGER_RESPONSE_RING_SIZE, po::value<int>()->default_value(65536),
+				"Only with triggerResponseRing: number of responses every receiver ring can hold, rounded up to the next power of two")
+
+		(OPTION_OVERLOAD_EVENT_NUMBER_MARGIN, po::value<int>()->default_value(1000),
+				"Number of event numbers above the highest one received which are considered as started when L0 MEPs start or stop being dropped")
+
+		(OPTION_TP_IDLE_SPINS, po::value<int>()->default_value(2000),
+				"Number of unsuccessful polls an idle TaskProcessor spins before it starts yielding")
+
+		(OPTION_TP_IDLE_YIELDS, po::value<int>()->default_value(20),
+				"Number of unsuccessful polls an idle TaskProcessor yields before it parks until new tasks are enqueued")
+
+		(OPTION_SH_IDLE_SPINS, po::value<int>()->default_value(200),
+				"Number of unsuccessful polls an idle StorageHandler spins before it starts yielding")
+
+		(OPTION_SH_IDLE_YIELDS, po::value<int>()->default_value(20),
+				"Number of unsuccessful polls an idle StorageHandler yields before it parks until new events are enqueued")
+
+		(OPTION_IDLE_PARK_TIMEOUT, po::value<int>()->default_value(10000),
+				"Maximum time in microseconds a parked thread sleeps before polling again")
+
+		(OPTION_SHARDED_EVENT_BUILDING, po::value<bool>()->default_value(false),
+				"If set to 1, every event is built by one single TaskProcessor chosen by its event number. Fragments received by other TaskProcessors are forwarded to it")
+
+		(OPTION_EVENT_SHARD_WIDTH, po::value<int>()->default_value(8),
+				"Number of consecutive event numbers built by the same TaskProcessor in sharded mode. Should be a multiple of the number of events per L0 MEP")
+
+		(OPTION_TASK_INITIAL_CAPACITY, po::value<int>()->default_value(4096),
+				"Number of frames every recycled HandleFrameTask can hold before its frame list has to grow. Grown tasks keep their capacity")
+
+		(OPTION_FRAME_POOL_SIZE, po::value<int>()->default_value(32768),
+				"Number of MTU sized frame buffers preallocated for every receive queue. Set to 0 to allocate every frame on the heap")
+
+		(OPTION_FRAME_POOL_HUGE_PAGES, po::value<bool>()->default_value(false),
+				"If set to 1, the frame buffers are allocated on huge pages")
+
+		(OPTION_VIRTUAL_SOURCE_POOL_SIZE, po::value<int>()->default_value(2048),
+				"Number of recycled L1, L2 and NSTD blocks per TaskProcessor. Blocks are allocated on the heap if the pool is empty or if an L0TP MEP has more than numberOfFragmentsPerMEP events. Set to 0 to disable the pool")
+
+		(OPTION_MEP_POOL_SIZE, po::value<int>()->default_value(32768),
+				"Number of recycled l0::MEP and l1::MEP objects per TaskProcessor. MEPs are allocated on the heap if the pool is empty. Set to 0 to disable the pool")
+
+		(OPTION_BATCH_PRE_PASS, po::value<bool>()->default_value(true),
+				"If set to 1, the headers of all frames of a batch are validated and classified in one pass before the frames are processed grouped by class (CREAM, L0, IP fragments, others). Set to 0 to process every frame on its own in arrival order")
+
+		(OPTION_CHECKSUM_VERIFICATION, po::value<int>()->default_value(2),
+				"0: Do not verify checksums. 1: Verify the IP header checksum. 2: Verify the IP header and UDP checksums. Can be changed at runtime with the command checksumverification:<mode>")
+
+		(OPTION_LOG_EXEMPLARS, po::value<int>()->default_value(3),
+				"Number of bad frames or events printed in detail per error category and monitoring interval. All others are only counted by source (maximum 8)")
+
+		(OPTION_FRAGMENT_TABLE_SIZE, po::value<int>()->default_value(4096),
+				"Number of IP datagrams which can be reassembled at the same time (rounded up to a power of two)")
+
+		(OPTION_FRAGMENT_TIMEOUT, po::value<int>()->default_value(1),
+				"Seconds after which the fragments of an incomplete IP datagram are freed. All incomplete datagrams are freed at the end of the burst")
+
+		(OPTION_LATENCY_HISTOGRAMS, po::value<bool>()->default_value(true),
+				"If set to 1, the distributions of the L0/L1 building, L1/L2 processing and serialization times are recorded (only in builds with MEASURE_TIME). Can be changed at runtime with the command latencyhistograms:<0|1>")
+
+		(OPTION_REASSEMBLE_IN_PACKET_HANDLER, po::value<bool>()->default_value(false),
+				"If set to 1, IP fragments are reassembled by the PacketHandler of their RX queue before the frames are passed to the TaskProcessors. Requires the NIC to distribute the frames over the queues by IP addresses only (no UDP ports) so that all fragments of a datagram are received on the same queue")
 
 		(OPTION_INCREMENT_BURST_AT_EOB, po::value<bool>()->default_value(false),
 				"Print out the source IDs and CREAM/crate IDs that have not been received during the last burst")
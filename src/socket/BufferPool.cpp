@@ -0,0 +1,205 @@
+/*
+ * BufferPool.cpp
+ *
+ *  Created on: Oct 17, 2026
+ */
+
+#include "BufferPool.h"
+
+#include <sys/mman.h>
+#include <cstdlib>
+#include <new>
+#include <algorithm>
+
+#include <options/Logging.h>
+
+namespace na62 {
+
+BufferPool* BufferPool::pools_[MAX_POOLS_];
+std::atomic<uint> BufferPool::numberOfPools_(0);
+
+static const size_t HUGE_PAGE_SIZE = 2 * 1024 * 1024;
+
+static inline size_t roundUp(size_t value, size_t alignment) {
+	return (value + alignment - 1) / alignment * alignment;
+}
+
+BufferPool::BufferPool() :
+		arenaBegin_(0), arenaSize_(0), bytesPerOwner_(0), bufferSize_(0), buffersPerOwner_(0), numberOfOwners_(0), owners_(
+				nullptr) {
+}
+
+void BufferPool::initialize(std::string name, uint numberOfOwners, size_t bufferSize, uint32_t buffersPerOwner,
+		bool hugePages) {
+	numberOfOwners_ = numberOfOwners;
+	buffersPerOwner_ = buffersPerOwner;
+	bufferSize_ = roundUp(std::max(bufferSize, sizeof(uint32_t)), 64);
+
+	void* ownerMemory;
+	if (posix_memalign(&ownerMemory, 64, sizeof(Owner) * numberOfOwners) != 0) {
+		throw std::bad_alloc();
+	}
+	owners_ = reinterpret_cast<Owner*>(ownerMemory);
+	for (uint i = 0; i != numberOfOwners; i++) {
+		Owner* owner = new (&owners_[i]) Owner();
+		owner->buffers = nullptr;
+		owner->localHead = EMPTY_;
+		owner->allocated = 0;
+		owner->exhaustions = 0;
+		owner->highWatermark = 0;
+		owner->returnedHead = EMPTY_;
+		owner->released = 0;
+	}
+
+	if (buffersPerOwner_ == 0 || numberOfOwners == 0) {
+		LOG_INFO(name << " pool disabled: buffers will be allocated on the heap");
+		return;
+	}
+
+	/*
+	 * Every owner gets its own huge pages so that each of them can be placed on another NUMA node
+	 */
+	bytesPerOwner_ = roundUp(bufferSize_ * buffersPerOwner_, HUGE_PAGE_SIZE);
+	const size_t totalBytes = bytesPerOwner_ * numberOfOwners;
+
+	void* arena = MAP_FAILED;
+	if (hugePages) {
+		arena = mmap(nullptr, totalBytes, PROT_READ | PROT_WRITE,
+		MAP_PRIVATE | MAP_ANONYMOUS | MAP_HUGETLB, -1, 0);
+		if (arena == MAP_FAILED) {
+			LOG_WARNING("Unable to map " << totalBytes << " B of huge pages for the " << name << " pool. Falling back to normal pages");
+		}
+	}
+	if (arena == MAP_FAILED) {
+		arena = mmap(nullptr, totalBytes, PROT_READ | PROT_WRITE,
+		MAP_PRIVATE | MAP_ANONYMOUS, -1, 0);
+	}
+	if (arena == MAP_FAILED) {
+		LOG_ERROR("Unable to map " << totalBytes << " B for the " << name << " pool: buffers will be allocated on the heap");
+		return;
+	}
+
+	for (uint i = 0; i != numberOfOwners; i++) {
+		owners_[i].buffers = reinterpret_cast<char*>(arena) + i * bytesPerOwner_;
+	}
+
+	arenaBegin_ = reinterpret_cast<uintptr_t>(arena);
+	arenaSize_ = totalBytes;
+
+	/*
+	 * Pools are initialized by the main thread only. Publish the pool after it is complete as
+	 * other threads may already be freeing buffers
+	 */
+	const uint poolNum = numberOfPools_.load(std::memory_order_relaxed);
+	if (poolNum == MAX_POOLS_) {
+		LOG_ERROR("Too many buffer pools: " << name << " buffers will never be recycled");
+	} else {
+		pools_[poolNum] = this;
+		numberOfPools_.store(poolNum + 1, std::memory_order_release);
+	}
+
+	LOG_INFO(name << " pool: " << numberOfOwners << " x " << buffersPerOwner_ << " buffers of " << bufferSize_ << " B");
+}
+
+void BufferPool::initializeOwner(uint ownerNum) {
+	Owner& owner = owners_[ownerNum];
+	if (owner.buffers == nullptr) {
+		return;
+	}
+
+	/*
+	 * Writing the free list touches every page of this owner from the calling thread
+	 */
+	for (uint32_t slot = 0; slot != buffersPerOwner_; slot++) {
+		nextOf(getBuffer(owner, slot)) = slot + 1 == buffersPerOwner_ ? EMPTY_ : slot + 1;
+	}
+	owner.localHead = 0;
+}
+
+char* BufferPool::allocate(uint ownerNum, size_t length) {
+	char* buffer = length > bufferSize_ ? nullptr : tryAllocate(ownerNum);
+	if (buffer == nullptr) {
+		Owner& owner = owners_[ownerNum];
+		owner.exhaustions.store(owner.exhaustions.load(std::memory_order_relaxed) + 1, std::memory_order_relaxed);
+		return new char[length];
+	}
+	return buffer;
+}
+
+char* BufferPool::tryAllocate(uint ownerNum) {
+	Owner& owner = owners_[ownerNum];
+
+	if (owner.localHead == EMPTY_) {
+		/*
+		 * Take over all buffers returned in the meantime
+		 */
+		owner.localHead = owner.returnedHead.exchange(EMPTY_, std::memory_order_acquire);
+		if (owner.localHead == EMPTY_) {
+			return nullptr;
+		}
+	}
+
+	char* buffer = getBuffer(owner, owner.localHead);
+	owner.localHead = nextOf(buffer);
+
+	const uint64_t allocated = owner.allocated.load(std::memory_order_relaxed) + 1;
+	owner.allocated.store(allocated, std::memory_order_relaxed);
+
+	uint inUse = allocated - owner.released.load(std::memory_order_relaxed);
+	if (inUse > owner.highWatermark.load(std::memory_order_relaxed)) {
+		owner.highWatermark.store(inUse, std::memory_order_relaxed);
+	}
+	return buffer;
+}
+
+void BufferPool::release(char* buffer) {
+	const size_t offset = reinterpret_cast<uintptr_t>(buffer) - arenaBegin_;
+	Owner& owner = owners_[offset / bytesPerOwner_];
+	const uint32_t slot = (offset % bytesPerOwner_) / bufferSize_;
+
+	uint32_t head = owner.returnedHead.load(std::memory_order_relaxed);
+	do {
+		nextOf(buffer) = head;
+	} while (!owner.returnedHead.compare_exchange_weak(head, slot, std::memory_order_release, std::memory_order_relaxed));
+
+	owner.released.fetch_add(1, std::memory_order_relaxed);
+}
+
+BufferPool* BufferPool::getOwningPool(const void* ptr) {
+	const uint numberOfPools = numberOfPools_.load(std::memory_order_acquire);
+	for (uint i = 0; i != numberOfPools; i++) {
+		if (pools_[i]->owns(ptr)) {
+			return pools_[i];
+		}
+	}
+	return nullptr;
+}
+
+uint64_t BufferPool::getNumberOfExhaustions() const {
+	uint64_t sum = 0;
+	for (uint i = 0; i != numberOfOwners_; i++) {
+		sum += owners_[i].exhaustions.load(std::memory_order_relaxed);
+	}
+	return sum;
+}
+
+uint BufferPool::getHighWatermark() const {
+	uint max = 0;
+	for (uint i = 0; i != numberOfOwners_; i++) {
+		max = std::max(max, owners_[i].highWatermark.load(std::memory_order_relaxed));
+	}
+	return max;
+}
+
+uint BufferPool::getNumberOfBuffersInUse() const {
+	uint sum = 0;
+	for (uint i = 0; i != numberOfOwners_; i++) {
+		/*
+		 * Not synchronized with the owner: good enough for monitoring
+		 */
+		sum += owners_[i].allocated.load(std::memory_order_relaxed) - owners_[i].released.load(std::memory_order_relaxed);
+	}
+	return sum;
+}
+
+} /* namespace na62 */
@@ -0,0 +1,159 @@
+/*
+ * BufferPool.h
+ *
+ * Recycled fixed size buffers, one free list per owning thread
+ *
+ *  Created on: Oct 17, 2026
+ */
+
+#ifndef BUFFERPOOL_H_
+#define BUFFERPOOL_H_
+
+#include <sys/types.h>
+#include <atomic>
+#include <cstddef>
+#include <cstdint>
+#include <string>
+
+#include <structs/DataContainer.h>
+
+namespace na62 {
+
+/*
+ * One set of fixed size buffers per owning thread.
+ *
+ * All sets are carved out of one single mmap'ed region so that the owner of a
+ * buffer is given by its address. Pooled buffers must therefore be freed with
+ * BufferPool::free() instead of DataContainer::free() or delete[]. Buffers passed
+ * to MEPs are returned by the MEPs created via MEPPool::create().
+ *
+ * Only the owner takes buffers from its set. Any thread may return one:
+ * returned buffers are pushed onto a lock free stack which is taken over as a
+ * whole by the owner as soon as its private free list runs empty. If both are
+ * empty the buffer is allocated on the heap.
+ */
+class BufferPool {
+public:
+	BufferPool();
+
+	/**
+	 * Reserves the memory of all owners. <buffersPerOwner> = 0 disables the pool
+	 */
+	void initialize(std::string name, uint numberOfOwners, size_t bufferSize, uint32_t buffersPerOwner, bool hugePages);
+
+	/**
+	 * Builds the free list of the given owner. Must be called by the owner after it has been pinned
+	 * so that the memory is touched first on the local NUMA node
+	 */
+	void initializeOwner(uint owner);
+
+	/**
+	 * Returns a buffer of at least <length> bytes. May only be called by <owner>
+	 */
+	char* allocate(uint owner, size_t length);
+
+	/**
+	 * Returns a buffer of bufferSize_ bytes or nullptr if the pool of <owner> is empty. May only be called by <owner>
+	 */
+	char* tryAllocate(uint owner);
+
+	/**
+	 * Returns a buffer to its owner. Thread safe, <buffer> must be owned by this pool (see owns())
+	 */
+	void release(char* buffer);
+
+	inline bool owns(const void* ptr) const {
+		return reinterpret_cast<uintptr_t>(ptr) - arenaBegin_ < arenaSize_;
+	}
+
+	/**
+	 * Returns the pool owning <ptr> or nullptr if it has been allocated on the heap
+	 */
+	static BufferPool* getOwningPool(const void* ptr);
+
+	/**
+	 * Releases <ptr> to the pool owning it. Returns false if it is not owned by any pool
+	 */
+	static inline bool releaseToOwningPool(void* ptr) {
+		BufferPool* pool = getOwningPool(ptr);
+		if (pool == nullptr) {
+			return false;
+		}
+		pool->release(static_cast<char*>(ptr));
+		return true;
+	}
+
+	/**
+	 * Frees the data of <container>: pooled buffers are returned to their owner, all others are deleted
+	 */
+	static inline void free(DataContainer& container) {
+		if (container.ownerMayFreeData && releaseToOwningPool(container.data)) {
+			container.data = nullptr;
+			return;
+		}
+		container.free();
+	}
+
+	/*
+	 * Number of times a buffer has been allocated on the heap because the pool was empty or too small
+	 */
+	uint64_t getNumberOfExhaustions() const;
+
+	/*
+	 * Highest number of buffers in use at the same time by any of the owners
+	 */
+	uint getHighWatermark() const;
+
+	uint getNumberOfBuffersInUse() const;
+
+	size_t getBufferSize() const {
+		return bufferSize_;
+	}
+
+private:
+	static const uint32_t EMPTY_ = 0xffffffff;
+	static const uint MAX_POOLS_ = 8;
+
+	struct alignas(64) Owner {
+		char* buffers;
+
+		/*
+		 * Only written by the owner
+		 */
+		uint32_t localHead;
+		std::atomic<uint64_t> allocated;
+
+		std::atomic<uint64_t> exhaustions;
+		std::atomic<uint> highWatermark;
+
+		/*
+		 * Written by all threads returning buffers
+		 */
+		alignas(64) std::atomic<uint32_t> returnedHead;
+		std::atomic<uint64_t> released;
+	};
+
+	inline char* getBuffer(const Owner& owner, uint32_t slot) const {
+		return owner.buffers + (size_t) slot * bufferSize_;
+	}
+
+	static inline uint32_t& nextOf(char* buffer) {
+		return *reinterpret_cast<uint32_t*>(buffer);
+	}
+
+	uintptr_t arenaBegin_;
+	uintptr_t arenaSize_;
+	size_t bytesPerOwner_;
+	size_t bufferSize_;
+	uint32_t buffersPerOwner_;
+
+	uint numberOfOwners_;
+	Owner* owners_;
+
+	static BufferPool* pools_[MAX_POOLS_];
+	static std::atomic<uint> numberOfPools_;
+};
+
+} /* namespace na62 */
+
+#endif /* BUFFERPOOL_H_ */
@@ -0,0 +1,217 @@
+/*
+ * ChecksumVerifier.cpp
+ *
+ *  Created on: Oct 17, 2026
+ */
+
+#include "ChecksumVerifier.h"
+
+#include <immintrin.h>
+#include <chrono>
+#include <cstring>
+#include <sstream>
+
+#include <eventBuilding/SourceIDManager.h>
+#include <l0/MEP.h>
+#include <options/Logging.h>
+#include <socket/EthernetUtils.h>
+
+#include "../options/MyOptions.h"
+
+namespace na62 {
+
+uint64_t (*ChecksumVerifier::sumImplementation_)(const char*, size_t, uint64_t) = &ChecksumVerifier::sumScalarUnfolded;
+
+std::atomic<uint> ChecksumVerifier::mode_(CHECKSUM_OFF);
+
+uint_fast16_t ChecksumVerifier::L0_Port;
+uint_fast16_t ChecksumVerifier::CREAM_Port;
+
+ChecksumVerifier::SourceIPFailures ChecksumVerifier::failuresBySourceIP_[SOURCE_IP_SLOTS];
+std::atomic<uint64_t> ChecksumVerifier::failuresBySourceID_[256];
+std::atomic<uint64_t> ChecksumVerifier::creamFailures_(0);
+std::atomic<uint64_t> ChecksumVerifier::failures_(0);
+
+void ChecksumVerifier::initialize() {
+	L0_Port = Options::GetInt(OPTION_L0_RECEIVER_PORT);
+	CREAM_Port = Options::GetInt(OPTION_CREAM_RECEIVER_PORT);
+
+	for (auto& slot : failuresBySourceIP_) {
+		slot.ip = 0;
+		slot.failures = 0;
+	}
+	for (auto& failures : failuresBySourceID_) {
+		failures = 0;
+	}
+
+	__builtin_cpu_init();
+	LOG_INFO("Checksum throughput scalar: " << measureThroughput(&sumScalarUnfolded) << " GB/s");
+	if (__builtin_cpu_supports("avx2")) {
+		sumImplementation_ = &sumAVX2Unfolded;
+		LOG_INFO("Checksum throughput AVX2: " << measureThroughput(&sumAVX2Unfolded) << " GB/s");
+	}
+
+	setMode(Options::GetInt(OPTION_CHECKSUM_VERIFICATION));
+}
+
+double ChecksumVerifier::measureThroughput(uint64_t (*implementation)(const char*, size_t, uint64_t)) {
+	static const uint ITERATIONS = 4096;
+	char frame[MTU];
+	for (uint i = 0; i != MTU; i++) {
+		frame[i] = i;
+	}
+
+	volatile uint64_t result = 0;
+	auto start = std::chrono::steady_clock::now();
+	for (uint i = 0; i != ITERATIONS; i++) {
+		result = result + implementation(frame, MTU, i);
+	}
+	auto stop = std::chrono::steady_clock::now();
+
+	const double nanos = std::chrono::duration_cast<std::chrono::nanoseconds>(stop - start).count();
+	return nanos == 0 ? 0 : (double) ITERATIONS * MTU / nanos;
+}
+
+void ChecksumVerifier::setMode(uint mode) {
+	if (mode > CHECKSUM_IP_UDP) {
+		LOG_ERROR("Unknown checksum verification mode " << mode << ": using " << CHECKSUM_IP_UDP);
+		mode = CHECKSUM_IP_UDP;
+	}
+	mode_ = mode;
+	LOG_INFO("Checksum verification mode " << mode << " (" << getImplementationName() << ")");
+}
+
+bool ChecksumVerifier::verifyUDP(const UDP_HDR* hdr) {
+	const uint_fast16_t udpLength = ntohs(hdr->udp.len);
+
+	/*
+	 * Pseudo header: source and destination IP, protocol and UDP length. All in network byte order
+	 * as the one's complement sum does not depend on the byte order as long as it's the same for all words
+	 */
+	uint64_t pseudoHeader = (uint64_t) hdr->ip.saddr + hdr->ip.daddr + htons(IPPROTO_UDP) + hdr->udp.len;
+
+	return sum(reinterpret_cast<const char*>(&hdr->udp), udpLength, pseudoHeader) == 0xffff;
+}
+
+uint64_t ChecksumVerifier::sumScalarUnfolded(const char* data, size_t length, uint64_t initial) {
+	uint64_t sum = initial;
+
+	/*
+	 * 32 bit words added to 64 bit cannot overflow for any realistic length
+	 */
+	while (length >= 16) {
+		uint32_t words[4];
+		memcpy(words, data, 16);
+		sum += (uint64_t) words[0] + words[1] + words[2] + words[3];
+		data += 16;
+		length -= 16;
+	}
+	while (length >= 4) {
+		uint32_t word;
+		memcpy(&word, data, 4);
+		sum += word;
+		data += 4;
+		length -= 4;
+	}
+	if (length >= 2) {
+		uint16_t word;
+		memcpy(&word, data, 2);
+		sum += word;
+		data += 2;
+		length -= 2;
+	}
+	if (length) {
+		/*
+		 * The odd byte is padded with a zero byte
+		 */
+		uint16_t word = 0;
+		memcpy(&word, data, 1);
+		sum += word;
+	}
+	return sum;
+}
+
+__attribute__((target("avx2")))
+uint64_t ChecksumVerifier::sumAVX2Unfolded(const char* data, size_t length, uint64_t initial) {
+	const __m256i zero = _mm256_setzero_si256();
+
+	/*
+	 * 32 bit words are zero extended to 64 bit lanes: each lane may take 2^32 additions
+	 */
+	__m256i sums = zero;
+	while (length >= 32) {
+		const __m256i words = _mm256_loadu_si256(reinterpret_cast<const __m256i*>(data));
+		sums = _mm256_add_epi64(sums, _mm256_unpacklo_epi32(words, zero));
+		sums = _mm256_add_epi64(sums, _mm256_unpackhi_epi32(words, zero));
+		data += 32;
+		length -= 32;
+	}
+
+	uint64_t lanes[4];
+	_mm256_storeu_si256(reinterpret_cast<__m256i*>(lanes), sums);
+
+	/*
+	 * Each lane sums up to 2^32 * 2^32: fold every lane separately before adding them
+	 */
+	uint64_t sum = initial;
+	for (uint64_t lane : lanes) {
+		sum += (lane & 0xffffffff) + (lane >> 32);
+	}
+	return sumScalarUnfolded(data, length, sum);
+}
+
+void ChecksumVerifier::countFailure(const UDP_HDR* hdr, uint length) {
+	failures_.fetch_add(1, std::memory_order_relaxed);
+
+	const uint32_t ip = hdr->ip.saddr;
+	uint slot = (ip * 2654435761u) % SOURCE_IP_SLOTS;
+	for (uint probe = 0; probe != SOURCE_IP_SLOTS; probe++, slot = (slot + 1) % SOURCE_IP_SLOTS) {
+		uint32_t current = failuresBySourceIP_[slot].ip.load(std::memory_order_relaxed);
+		if (current == 0 && failuresBySourceIP_[slot].ip.compare_exchange_strong(current, ip, std::memory_order_relaxed)) {
+			current = ip;
+		}
+		if (current == ip) {
+			failuresBySourceIP_[slot].failures.fetch_add(1, std::memory_order_relaxed);
+			break;
+		}
+	}
+
+	/*
+	 * Only the first fragment and unfragmented datagrams carry the UDP and MEP headers
+	 */
+	if ((ntohs(hdr->ip.frag_off) & 0x1fff) != 0) {
+		return;
+	}
+	const uint_fast16_t destPort = ntohs(hdr->udp.dest);
+	if (destPort == CREAM_Port) {
+		creamFailures_.fetch_add(1, std::memory_order_relaxed);
+	} else if (destPort == L0_Port && length >= sizeof(UDP_HDR) + sizeof(l0::MEP_HDR)) {
+		const l0::MEP_HDR* mepHdr = reinterpret_cast<const l0::MEP_HDR*>(reinterpret_cast<const char*>(hdr) + sizeof(UDP_HDR));
+		failuresBySourceID_[mepHdr->sourceID].fetch_add(1, std::memory_order_relaxed);
+	}
+}
+
+std::string ChecksumVerifier::serializeFailuresBySourceIP() {
+	std::stringstream stream;
+	for (auto& slot : failuresBySourceIP_) {
+		const uint32_t ip = slot.ip.load(std::memory_order_relaxed);
+		if (ip != 0) {
+			stream << EthernetUtils::ipToString(ip) << ":" << slot.failures.load(std::memory_order_relaxed) << ";";
+		}
+	}
+	return stream.str();
+}
+
+std::string ChecksumVerifier::serializeFailuresByDetector() {
+	std::stringstream stream;
+	for (uint sourceID = 0; sourceID != 256; sourceID++) {
+		const uint64_t failures = failuresBySourceID_[sourceID].load(std::memory_order_relaxed);
+		if (failures != 0) {
+			stream << "0x" << std::hex << sourceID << std::dec << ":" << failures << ";";
+		}
+	}
+	stream << "CREAM:" << creamFailures_.load(std::memory_order_relaxed) << ";";
+	return stream.str();
+}
+
+} /* namespace na62 */
@@ -0,0 +1,155 @@
+/*
+ * ChecksumVerifier.h
+ *
+ * Verification of the IP header and UDP checksums of received frames
+ *
+ *  Created on: Oct 17, 2026
+ */
+
+#ifndef CHECKSUMVERIFIER_H_
+#define CHECKSUMVERIFIER_H_
+
+#include <sys/types.h>
+#include <atomic>
+#include <cstddef>
+#include <cstdint>
+#include <string>
+
+#include <structs/Network.h>
+
+namespace na62 {
+
+/*
+ * CHECKSUM_OFF:    Nothing is verified
+ * CHECKSUM_IP:     Only the IP header checksum is verified
+ * CHECKSUM_IP_UDP: Additionally the UDP checksum of unfragmented datagrams is verified.
+ *                  Datagrams with a UDP checksum of 0 (not computed by the sender) are accepted
+ */
+enum ChecksumMode : uint {
+	CHECKSUM_OFF = 0, CHECKSUM_IP = 1, CHECKSUM_IP_UDP = 2
+};
+
+class ChecksumVerifier {
+public:
+	/**
+	 * Selects the AVX2 or the scalar implementation depending on the CPU and reads the initial mode
+	 */
+	static void initialize();
+
+	/**
+	 * May be called at any time, e.g. by the CommandConnector
+	 */
+	static void setMode(uint mode);
+
+	static inline ChecksumMode getMode() {
+		return (ChecksumMode) mode_.load(std::memory_order_relaxed);
+	}
+
+	/**
+	 * Returns true if the checksums enabled by the current mode are correct. <length> must be checked
+	 * against ip.tot_len and udp.len before
+	 */
+	static inline bool verify(const UDP_HDR* hdr, uint length) {
+		const ChecksumMode mode = getMode();
+		if (mode == CHECKSUM_OFF) {
+			return true;
+		}
+		if (!verifyIPHeader(hdr, length)) {
+			return false;
+		}
+		if (mode == CHECKSUM_IP_UDP && hdr->udp.check != 0 && (hdr->ip.frag_off & 0xff3f) == 0/*!isFragment()*/) {
+			return verifyUDP(hdr);
+		}
+		return true;
+	}
+
+	/**
+	 * Same as verify() but failures are counted by source IP and detector
+	 */
+	static inline bool check(const UDP_HDR* hdr, uint length) {
+		if (verify(hdr, length)) {
+			return true;
+		}
+		countFailure(hdr, length);
+		return false;
+	}
+
+	/**
+	 * One's complement sum of <length> bytes folded to 16 bit, in network byte order. <initial> is added
+	 */
+	static inline uint16_t sum(const char* data, size_t length, uint64_t initial = 0) {
+		return fold(sumImplementation_(data, length, initial));
+	}
+
+	static uint64_t getNumberOfFailures() {
+		return failures_;
+	}
+
+	/*
+	 * "a.b.c.d:failures;" for every source IP with failures
+	 */
+	static std::string serializeFailuresBySourceIP();
+
+	/*
+	 * "0x<sourceID>:failures;" for every L0 source with failures and "CREAM:failures;"
+	 */
+	static std::string serializeFailuresByDetector();
+
+	static const char* getImplementationName() {
+		return sumImplementation_ == &sumScalarUnfolded ? "scalar" : "AVX2";
+	}
+
+private:
+	static inline uint16_t fold(uint64_t sum) {
+		sum = (sum & 0xffffffff) + (sum >> 32);
+		sum = (sum & 0xffffffff) + (sum >> 32);
+		sum = (sum & 0xffff) + (sum >> 16);
+		sum = (sum & 0xffff) + (sum >> 16);
+		return sum;
+	}
+
+	static inline bool verifyIPHeader(const UDP_HDR* hdr, uint length) {
+		const uint headerLength = hdr->ip.ihl * 4;
+		if (headerLength < sizeof(iphdr) || headerLength + sizeof(ether_header) > length) {
+			return false;
+		}
+		return sum(reinterpret_cast<const char*>(&hdr->ip), headerLength) == 0xffff;
+	}
+
+	static bool verifyUDP(const UDP_HDR* hdr);
+
+	static void countFailure(const UDP_HDR* hdr, uint length);
+
+	static uint64_t sumScalarUnfolded(const char* data, size_t length, uint64_t initial);
+	static uint64_t sumAVX2Unfolded(const char* data, size_t length, uint64_t initial);
+
+	/**
+	 * Returns the throughput in GB/s of the given implementation summing MTU sized frames
+	 */
+	static double measureThroughput(uint64_t (*implementation)(const char*, size_t, uint64_t));
+
+	static uint64_t (*sumImplementation_)(const char*, size_t, uint64_t);
+
+	static std::atomic<uint> mode_;
+
+	static uint_fast16_t L0_Port;
+	static uint_fast16_t CREAM_Port;
+
+	/*
+	 * Open addressing table of the source IPs with failures. An IP is never removed
+	 */
+	static const uint SOURCE_IP_SLOTS = 512;
+	struct SourceIPFailures {
+		std::atomic<uint32_t> ip;
+		std::atomic<uint64_t> failures;
+	};
+	static SourceIPFailures failuresBySourceIP_[SOURCE_IP_SLOTS];
+
+	static std::atomic<uint64_t> failuresBySourceID_[256];
+	static std::atomic<uint64_t> creamFailures_;
+	static std::atomic<uint64_t> failures_;
+};
+
+} /* namespace na62 */
+
+#endif /* CHECKSUMVERIFIER_H_ */
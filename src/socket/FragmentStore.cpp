@@ -7,13 +7,356 @@
 
 #include "FragmentStore.h"
 
+#include <algorithm>
+#include <cstdlib>
+#include <cstring>
+#include <new>
+#include <sstream>
+
+#include <options/Logging.h>
+#include <socket/EthernetUtils.h>
+
+#include "../options/MyOptions.h"
+#include "../utils/RateLimitedLog.h"
+#include "BufferPool.h"
+
 namespace na62 {
 
-const uint FragmentStore::numberOfFragmentStores_;
-std::map<uint64_t, std::vector<DataContainer>> FragmentStore::fragmentsById_[];
-tbb::spin_mutex FragmentStore::newFragmentMutexes_[];
+uint FragmentStore::numberOfSlots_ = 0;
+FragmentStore::Slot* FragmentStore::slots_ = nullptr;
 
 std::atomic<uint> FragmentStore::numberOfFragmentsReceived_(0);
 std::atomic<uint> FragmentStore::numberOfReassembledFrames_(0);
+std::atomic<uint> FragmentStore::numberOfDroppedFragments_(0);
+std::atomic<uint> FragmentStore::numberOfUnfinishedFrames_(0);
+
+uint FragmentStore::timeout_ = 0;
+std::atomic<uint> FragmentStore::generation_(0);
+std::atomic<uint> FragmentStore::evictionGeneration_(0);
+
+std::atomic<uint64_t> FragmentStore::numberOfStaleFrames_(0);
+std::atomic<uint64_t> FragmentStore::numberOfStaleFragments_(0);
+FragmentStore::SourceIPFragments FragmentStore::staleFragmentsBySourceIP_[SOURCE_IP_SLOTS];
+
+void FragmentStore::initialize() {
+	/*
+	 * Power of two so that the hash can be masked
+	 */
+	numberOfSlots_ = 1;
+	while (numberOfSlots_ < (uint) Options::GetInt(OPTION_FRAGMENT_TABLE_SIZE)) {
+		numberOfSlots_ <<= 1;
+	}
+
+	void* memory;
+	if (posix_memalign(&memory, alignof(Slot), numberOfSlots_ * sizeof(Slot)) != 0) {
+		throw std::bad_alloc();
+	}
+	slots_ = reinterpret_cast<Slot*>(memory);
+
+	for (uint i = 0; i != numberOfSlots_; i++) {
+		Slot* slot = new (&slots_[i]) Slot();
+		slot->key = FREE;
+		slot->generation = NO_GENERATION;
+		slot->claiming = false;
+		slot->users = 0;
+		slot->numberOfFragments = 0;
+		slot->bytes = 0;
+		for (Fragment& fragment : slot->fragments) {
+			fragment.data = nullptr;
+		}
+	}
+	for (SourceIPFragments& source : staleFragmentsBySourceIP_) {
+		source.ip = 0;
+		source.fragments = 0;
+	}
+
+	timeout_ = std::max(Options::GetInt(OPTION_FRAGMENT_TIMEOUT), 1);
+	LOG_INFO("IP fragment table: " << numberOfSlots_ << " datagrams of up to " << MAX_FRAGMENTS << " fragments, evicted after "
+			<< timeout_ << " s");
+}
+
+DataContainer FragmentStore::addFragment(DataContainer&& fragment) {
+	UDP_HDR* hdr = (UDP_HDR*) fragment.data;
+	const uint64_t fragID = generateFragmentID(hdr->ip.saddr, hdr->ip.id);
+	numberOfFragmentsReceived_++;
+	RateLimitedLog::report(IP_FRAGMENT_RECEIVED, hdr->ip.saddr, ntohs(hdr->ip.id));
+
+	const uint totalLength = ntohs(hdr->ip.tot_len);
+	if (totalLength < sizeof(iphdr) || totalLength + sizeof(ether_header) > fragment.length) {
+		RateLimitedLog::report(BAD_IP_FRAGMENTS, hdr->ip.saddr, ntohs(hdr->ip.id), 0, "ip.tot_len does not match the frame length");
+		numberOfDroppedFragments_++;
+		BufferPool::free(fragment);
+		return DataContainer { nullptr, 0, false };
+	}
+
+	const uint payloadBytes = totalLength - sizeof(iphdr);
+	const uint offset = hdr->getFragmentOffsetInBytes();
+	const bool isLastFragment = !hdr->isMoreFragments();
+
+	Slot* slot = enterSlot(fragID);
+	if (slot == nullptr) {
+		RateLimitedLog::report(BAD_IP_FRAGMENTS, hdr->ip.saddr, ntohs(hdr->ip.id), 0, "Fragment table full");
+		numberOfDroppedFragments_++;
+		BufferPool::free(fragment);
+		return DataContainer { nullptr, 0, false };
+	}
+
+	const uint index = slot->numberOfFragments.fetch_add(1, std::memory_order_relaxed);
+	if (index >= MAX_FRAGMENTS) {
+		/*
+		 * The payload is not counted so the datagram will never be complete
+		 */
+		RateLimitedLog::report(BAD_IP_FRAGMENTS, hdr->ip.saddr, ntohs(hdr->ip.id), 0, "Too many fragments");
+		numberOfDroppedFragments_++;
+		BufferPool::free(fragment);
+		leaveSlot(slot);
+		return DataContainer { nullptr, 0, false };
+	}
+
+	Fragment& entry = slot->fragments[index];
+	entry.length = fragment.length;
+	entry.ownerMayFreeData = fragment.ownerMayFreeData;
+	entry.offset = offset;
+	entry.data.store(fragment.data, std::memory_order_release);
+	fragment.data = nullptr;
+
+	/*
+	 * Publishes the entry to the thread completing the datagram
+	 */
+	const uint64_t increment = payloadBytes + (isLastFragment ? (uint64_t) (offset + payloadBytes) << 32 : 0);
+	const uint64_t bytes = slot->bytes.fetch_add(increment, std::memory_order_acq_rel) + increment;
+
+	DataContainer reassembledFrame { nullptr, 0, false };
+	if (isLastFragment && (bytes - increment) >> 32 != 0) {
+		RateLimitedLog::report(BAD_IP_FRAGMENTS, hdr->ip.saddr, ntohs(hdr->ip.id), 0, "Too many last fragments");
+		numberOfDroppedFragments_++;
+		uint64_t key = fragID;
+		slot->key.compare_exchange_strong(key, RELEASING, std::memory_order_acq_rel);
+	} else {
+		const uint expectedPayloadBytes = bytes >> 32;
+		if (expectedPayloadBytes != 0 && (bytes & 0xffffffff) == expectedPayloadBytes) {
+			reassembledFrame = reassembleFrame(slot, expectedPayloadBytes);
+			slot->key.store(RELEASING, std::memory_order_release);
+		}
+	}
+
+	leaveSlot(slot);
+	return reassembledFrame;
+}
+
+FragmentStore::Slot* FragmentStore::enterSlot(const uint64_t fragID) {
+	const uint mask = numberOfSlots_ - 1;
+	const uint firstIndex = (fragID * 0x9E3779B97F4A7C15ull) >> 32;
+
+	/*
+	 * Join the slot of the datagram if it exists already
+	 */
+	Slot* slot = findSlot(fragID, firstIndex);
+	if (slot != nullptr) {
+		return slot;
+	}
+
+	/*
+	 * Otherwise take the first free one. Claims of one datagram are serialized by the first probe position
+	 * and the search is repeated: another thread may have claimed a slot since, possibly before a slot freed
+	 * in the meantime, and the fragments of a datagram must never be split over two slots
+	 */
+	std::atomic<bool>& claiming = slots_[firstIndex & mask].claiming;
+	while (claiming.exchange(true, std::memory_order_acquire)) {
+		while (claiming.load(std::memory_order_relaxed)) {
+#if defined(__x86_64__) || defined(__i386__)
+			__builtin_ia32_pause();
+#endif
+		}
+	}
+
+	slot = findSlot(fragID, firstIndex);
+	for (uint probe = 0; slot == nullptr && probe != MAX_PROBES; probe++) {
+		Slot* freeSlot = &slots_[(firstIndex + probe) & mask];
+		uint64_t key = FREE;
+		if (freeSlot->key.compare_exchange_strong(key, fragID, std::memory_order_acq_rel)) {
+			freeSlot->generation.store(generation_.load(std::memory_order_relaxed), std::memory_order_release);
+			numberOfUnfinishedFrames_.fetch_add(1, std::memory_order_relaxed);
+			if (tryEnter(freeSlot, fragID)) {
+				slot = freeSlot;
+			}
+		}
+	}
+
+	claiming.store(false, std::memory_order_release);
+	return slot;
+}
+
+FragmentStore::Slot* FragmentStore::findSlot(const uint64_t fragID, const uint firstIndex) {
+	const uint mask = numberOfSlots_ - 1;
+	for (uint probe = 0; probe != MAX_PROBES; probe++) {
+		Slot* slot = &slots_[(firstIndex + probe) & mask];
+		if (slot->key.load(std::memory_order_acquire) == fragID && tryEnter(slot, fragID)) {
+			return slot;
+		}
+	}
+	return nullptr;
+}
+
+bool FragmentStore::tryEnter(Slot* slot, const uint64_t fragID) {
+	slot->users.fetch_add(1, std::memory_order_acq_rel);
+	if (slot->key.load(std::memory_order_acquire) == fragID) {
+		return true;
+	}
+	leaveSlot(slot);
+	return false;
+}
+
+void FragmentStore::leaveSlot(Slot* slot) {
+	if (slot->users.fetch_sub(1, std::memory_order_acq_rel) != 1) {
+		return;
+	}
+
+	/*
+	 * Threads entering from now on see that the key does not match theirs and leave without touching the slot
+	 */
+	uint64_t key = RELEASING;
+	if (!slot->key.compare_exchange_strong(key, CLEANING, std::memory_order_acq_rel)) {
+		return;
+	}
+
+	const uint numberOfFragments = std::min(slot->numberOfFragments.load(std::memory_order_relaxed), MAX_FRAGMENTS);
+	for (uint i = 0; i != numberOfFragments; i++) {
+		Fragment& fragment = slot->fragments[i];
+		char* data = fragment.data.exchange(nullptr, std::memory_order_acquire);
+		if (data != nullptr) {
+			freeFragment(data, fragment.length, fragment.ownerMayFreeData);
+		}
+	}
+	slot->numberOfFragments.store(0, std::memory_order_relaxed);
+	slot->bytes.store(0, std::memory_order_relaxed);
+	slot->generation.store(NO_GENERATION, std::memory_order_relaxed);
+	numberOfUnfinishedFrames_.fetch_sub(1, std::memory_order_relaxed);
+	slot->key.store(FREE, std::memory_order_release);
+}
+
+void FragmentStore::evictStaleFrames(const bool burstFinished) {
+	const uint generation = generation_.fetch_add(1, std::memory_order_relaxed) + 1;
+	const uint evictionGeneration = burstFinished ? generation : (generation > timeout_ ? generation - timeout_ : 0);
+
+	/*
+	 * Called by the MonitorConnector and at EOB at the same time: the lower value of the periodic call
+	 * must not hide the EOB flush from the QueueFragmentStores
+	 */
+	uint published = evictionGeneration_.load(std::memory_order_relaxed);
+	while (published < evictionGeneration
+			&& !evictionGeneration_.compare_exchange_weak(published, evictionGeneration, std::memory_order_release,
+					std::memory_order_relaxed)) {
+	}
+
+	for (uint i = 0; i != numberOfSlots_; i++) {
+		Slot* slot = &slots_[i];
+		uint64_t key = slot->key.load(std::memory_order_acquire);
+		if (key == FREE || key == RELEASING || key == CLEANING
+				|| slot->generation.load(std::memory_order_acquire) >= evictionGeneration) {
+			continue;
+		}
+
+		/*
+		 * Enter the slot like a TaskProcessor so that it is freed by the last thread leaving it
+		 */
+		slot->users.fetch_add(1, std::memory_order_acq_rel);
+		if (slot->key.compare_exchange_strong(key, RELEASING, std::memory_order_acq_rel)) {
+			const uint numberOfFragments = std::min(slot->numberOfFragments.load(std::memory_order_relaxed), MAX_FRAGMENTS);
+			countStaleFrame(key >> 16, numberOfFragments);
+			RateLimitedLog::report(STALE_IP_FRAGMENTS, key >> 16, ntohs(key & 0xffff), numberOfFragments);
+		}
+		leaveSlot(slot);
+	}
+}
+
+void FragmentStore::countStaleFrame(uint32_t sourceIP, uint numberOfFragments) {
+	numberOfStaleFrames_.fetch_add(1, std::memory_order_relaxed);
+	numberOfStaleFragments_.fetch_add(numberOfFragments, std::memory_order_relaxed);
+
+	uint slot = (sourceIP * 2654435761u) % SOURCE_IP_SLOTS;
+	for (uint probe = 0; probe != SOURCE_IP_SLOTS; probe++, slot = (slot + 1) % SOURCE_IP_SLOTS) {
+		uint32_t current = staleFragmentsBySourceIP_[slot].ip.load(std::memory_order_relaxed);
+		if (current == 0 && staleFragmentsBySourceIP_[slot].ip.compare_exchange_strong(current, sourceIP, std::memory_order_relaxed)) {
+			current = sourceIP;
+		}
+		if (current == sourceIP) {
+			staleFragmentsBySourceIP_[slot].fragments.fetch_add(numberOfFragments, std::memory_order_relaxed);
+			break;
+		}
+	}
+}
+
+std::string FragmentStore::serializeStaleFragmentsBySourceIP() {
+	std::stringstream stream;
+	for (SourceIPFragments& source : staleFragmentsBySourceIP_) {
+		const uint32_t ip = source.ip.load(std::memory_order_relaxed);
+		if (ip != 0) {
+			stream << EthernetUtils::ipToString(ip) << ":" << source.fragments.load(std::memory_order_relaxed) << ";";
+		}
+	}
+	return stream.str();
+}
+
+DataContainer FragmentStore::reassembleFrame(Slot* slot, const uint expectedPayloadBytes) {
+	/*
+	 * Sort the fragments by offset
+	 */
+	uint order[MAX_FRAGMENTS];
+	uint numberOfFragments = 0;
+	const uint claimed = std::min(slot->numberOfFragments.load(std::memory_order_relaxed), MAX_FRAGMENTS);
+	for (uint i = 0; i != claimed; i++) {
+		if (slot->fragments[i].data.load(std::memory_order_acquire) == nullptr) {
+			continue;
+		}
+		uint position = numberOfFragments++;
+		while (position != 0 && slot->fragments[order[position - 1]].offset > slot->fragments[i].offset) {
+			order[position] = order[position - 1];
+			position--;
+		}
+		order[position] = i;
+	}
+
+	/*
+	 * We'll copy the ethernet and IP header of the first frame plus all IP-Payload of all frames
+	 */
+	const uint headerBytes = sizeof(ether_header) + sizeof(iphdr);
+	const uint_fast32_t totalBytes = headerBytes + expectedPayloadBytes;
+	char* newFrameBuff = new char[totalBytes];
+
+	uint currentOffset = 0;
+	for (uint i = 0; i != numberOfFragments; i++) {
+		Fragment& fragment = slot->fragments[order[i]];
+		UDP_HDR* currentData = (UDP_HDR*) fragment.data.load(std::memory_order_relaxed);
+		const uint payloadBytes = ntohs(currentData->ip.tot_len) - sizeof(iphdr);
+
+		if (fragment.offset != currentOffset || currentOffset + payloadBytes > expectedPayloadBytes) {
+			RateLimitedLog::report(BAD_IP_FRAGMENTS, currentData->ip.saddr, ntohs(currentData->ip.id), currentOffset,
+					"Sum of fragment lengths does not match the offset of the next fragment");
+			numberOfDroppedFragments_ += numberOfFragments;
+			delete[] newFrameBuff;
+			return DataContainer { nullptr, 0, false };
+		}
+
+		if (i == 0) {
+			memcpy(newFrameBuff, currentData, headerBytes);
+		}
+		memcpy(newFrameBuff + headerBytes + currentOffset, reinterpret_cast<char*>(currentData) + headerBytes, payloadBytes);
+		currentOffset += payloadBytes;
+	}
+
+	/*
+	 * The fragments are freed by the thread leaving the slot last
+	 */
+	numberOfReassembledFrames_++;
+	UDP_HDR* hdr = (UDP_HDR*) newFrameBuff;
+	RateLimitedLog::report(IP_FRAME_REASSEMBLED, hdr->ip.saddr, ntohs(hdr->ip.id), totalBytes);
+	return DataContainer { newFrameBuff, (uint_fast16_t) totalBytes, true };
+}
+
+void FragmentStore::freeFragment(char* data, uint_fast16_t length, bool ownerMayFreeData) {
+	DataContainer container { data, length, ownerMayFreeData };
+	BufferPool::free(container);
+}
 
 } /* namespace na62 */
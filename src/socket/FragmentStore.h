@@ -10,79 +10,39 @@
 #ifndef FRAGMENTSTORE_H_
 #define FRAGMENTSTORE_H_
 
-#include <socket/EthernetUtils.h>
 #include <structs/Network.h>
 #include <sys/types.h>
-#include <map>
-#include <vector>
-#include <tbb/spin_mutex.h>
 #include <atomic>
-
-#include <algorithm>
-#include <iterator>
-
-#include <options/Logging.h>
+#include <cstdint>
+#include <string>
 
 namespace na62 {
 
+/*
+ * Open addressing table of the IP datagrams being reassembled. All slots are allocated at
+ * initialization and no lock is taken: the fragments of one datagram may be added by several
+ * TaskProcessors at the same time.
+ *
+ * Every slot counts the received payload bytes and, as soon as the last fragment arrived, the expected
+ * ones in one atomic word. The thread whose fragment completes the datagram sees both numbers equal
+ * and reassembles it. The slot is freed by the last thread leaving it afterwards.
+ *
+ * Every slot is tagged with the generation it has been claimed in. Datagrams still incomplete after
+ * fragmentTimeout generations (seconds) or at the end of the burst are evicted by evictStaleFrames().
+ */
 class FragmentStore {
 
 public:
-	static DataContainer&& addFragment(DataContainer&& fragment) {
-		UDP_HDR* hdr = (UDP_HDR*) fragment.data;
-		const uint64_t fragID = generateFragmentID(hdr->ip.saddr, hdr->ip.id);
-		const uint fragmentStoreNum = fragID % numberOfFragmentStores_; // In this way you will alwais have a number from 0 to numberOfFragmentStores_
-		numberOfFragmentsReceived_++;
-		LOG_INFO("Fragmented packet from " << EthernetUtils::ipToString(hdr->ip.saddr) << " fragmentStoreNum " << fragmentStoreNum << " fragID " << fragID);
+	/**
+	 * Must be called before the first fragment is added
+	 */
+	static void initialize();
 
-		/*
-		 * Synchronize fragmentsById access
-		 */
-		tbb::spin_mutex::scoped_lock my_lock(
-				newFragmentMutexes_[fragmentStoreNum]);
-
-		auto& fragmentsReceived = fragmentsById_[fragmentStoreNum][fragID];
-		fragmentsReceived.push_back(std::move(fragment));
-
-		uint sumOfIPPayloadBytes = 0;
-		UDP_HDR* lastFragment = nullptr;
-		//LOG_INFO("Fragmented packet from " << EthernetUtils::ipToString(hdr->ip.saddr) << " Number of fragments received " << fragmentsReceived.size());
-		uint_fast8_t last_fragment_counter = 0;
-		for (auto& frag : fragmentsReceived) {
-			UDP_HDR* tmp_hdr = (UDP_HDR*) frag.data;
-			sumOfIPPayloadBytes += ntohs(tmp_hdr->ip.tot_len) - sizeof(iphdr);
-
-			if (!tmp_hdr->isMoreFragments()) {
-				lastFragment = tmp_hdr;
-				++last_fragment_counter;
-				//LOG_INFO("Fragmented packet from " << EthernetUtils::ipToString(tmp_hdr->ip.saddr) << " is the last fragment");
-			}
-		}
-
-		if (last_fragment_counter > 1) {
-			//We have received too many final fragments purging the memory
-			LOG_ERROR("Fragmented packet from " << EthernetUtils::ipToString(hdr->ip.saddr) << " Too many last fragments.. " << last_fragment_counter);
-			cleanAll(fragmentStoreNum, fragID);
-			return std::move(empty());
-		}
-
-		if (lastFragment != nullptr) {
-			//LOG_INFO("Fragmented packet from " << EthernetUtils::ipToString(hdr->ip.saddr) << " the last packet is arrived, number of fragments received " << fragmentsReceived.size());
-			uint expectedPayloadSum = lastFragment->getFragmentOffsetInBytes()
-					+ ntohs(lastFragment->ip.tot_len) - sizeof(iphdr);
-			/*
-			 * Check if we've received as many bytes as the offset of the last fragment plus its size
-			 */
-			//LOG_INFO("Fragmented packet from " << EthernetUtils::ipToString(hdr->ip.saddr) << " expectedPayloadSum: " << expectedPayloadSum << " sumOfIPPayloadBytes " << sumOfIPPayloadBytes );
-			if (expectedPayloadSum == sumOfIPPayloadBytes) {
-				numberOfReassembledFrames_++;
-				DataContainer reassembledFrame = reassembleFrame(fragmentStoreNum, fragID);
-				cleanAll(fragmentStoreNum, fragID);
-				return std::move(reassembledFrame);
-			}
-		}
-		return std::move(empty());
-	}
+	/**
+	 * Takes over the fragment. Returns the reassembled frame if this fragment completed its datagram
+	 * and an empty container (data == nullptr) otherwise
+	 */
+	static DataContainer addFragment(DataContainer&& fragment);
 
 	static uint getNumberOfReceivedFragments() {
 		return numberOfFragmentsReceived_;
@@ -93,107 +53,150 @@ public:
 	}
 
 	static uint getNumberOfUnfinishedFrames() {
-		uint sum = 0;
-		for (auto store : fragmentsById_) {
-			sum += store.size();
-		}
-		return sum;
+		return numberOfUnfinishedFrames_;
 	}
 
-private:
-	static const uint numberOfFragmentStores_ = 32;
-	static std::map<uint64_t, std::vector<DataContainer>> fragmentsById_[numberOfFragmentStores_];
-	static tbb::spin_mutex newFragmentMutexes_[numberOfFragmentStores_];
+	/*
+	 * Fragments dropped because the table or the slot of their datagram was full or the datagram was inconsistent
+	 */
+	static uint getNumberOfDroppedFragments() {
+		return numberOfDroppedFragments_;
+	}
 
-	static std::atomic<uint> numberOfFragmentsReceived_;
-	static std::atomic<uint> numberOfReassembledFrames_;
+	/**
+	 * Advances the fragment clock by one generation and frees all datagrams older than fragmentTimeout
+	 * generations, or all datagrams started before this call if <burstFinished> is set. Called every
+	 * second by the MonitorConnector and at the end of every burst
+	 */
+	static void evictStaleFrames(const bool burstFinished);
 
-	static inline uint64_t generateFragmentID(const uint_fast32_t srcIP,
-			const uint_fast16_t fragID) {
-		return (uint64_t) fragID | ((uint64_t) srcIP << 16);
+	static inline uint getGeneration() {
+		return generation_.load(std::memory_order_relaxed);
 	}
 
-	static DataContainer&& empty(){
-		DataContainer empty{nullptr, 0, false};
-		return std::move(empty);
+	/*
+	 * Datagrams started in an older generation are stale. Never decreases
+	 */
+	static inline uint getEvictionGeneration() {
+		return evictionGeneration_.load(std::memory_order_acquire);
 	}
 
-	static void cleanAll(const uint fragmentStoreNum, const uint64_t fragID) {
-		//Free the fragments memory
-		for (auto& frag : fragmentsById_[fragmentStoreNum][fragID]) {
-			if (frag.data != nullptr) {
-				frag.free();
-			}
-		}
-		fragmentsById_[fragmentStoreNum][fragID].clear();
-		fragmentsById_[fragmentStoreNum].erase(fragID);
-
-//		if (fragmentsById_[fragmentStoreNum].find(fragID) == fragmentsById_[fragmentStoreNum].end()) {
-//			LOG_ERROR("Fragmented packet from " << EthernetUtils::ipToString(hdr->ip.saddr) << " Element " << fragID << " correctly deleted ");
-//		} else {
-//			LOG_ERROR("Fragmented packet from " << EthernetUtils::ipToString(hdr->ip.saddr) << " !!!!! Element " << fragID << " not deleted ");
-//		}
-		LOG_INFO("Cleaned fragmentStoreNum: " << fragmentStoreNum << " fragID: " << fragID);
+	/**
+	 * Counts the fragments of a datagram evicted by this or the per queue store
+	 */
+	static void countStaleFrame(uint32_t sourceIP, uint numberOfFragments);
+
+	static uint64_t getNumberOfStaleFrames() {
+		return numberOfStaleFrames_;
+	}
+
+	static uint64_t getNumberOfStaleFragments() {
+		return numberOfStaleFragments_;
 	}
 
-	static DataContainer&& reassembleFrame(const uint fragmentStoreNum, const uint64_t fragID) {
-		auto& fragments = fragmentsById_[fragmentStoreNum][fragID];
+	/*
+	 * "a.b.c.d:fragments;" for every source IP with stale fragments
+	 */
+	static std::string serializeStaleFragmentsBySourceIP();
+
+private:
+	/*
+	 * 64 kB datagrams in fragments of 1500 B
+	 */
+	static const uint MAX_FRAGMENTS = 48;
+	static const uint MAX_PROBES = 16;
+
+	/*
+	 * Keys of slots not belonging to a datagram. Datagram keys are (srcIP << 16 | ip.id) and use 48 bit only
+	 */
+	static const uint64_t FREE = 0;
+	static const uint64_t RELEASING = 1ull << 63;
+	static const uint64_t CLEANING = 1ull << 62;
+
+	/*
+	 * Generation of slots being claimed or freed: never stale
+	 */
+	static const uint NO_GENERATION = ~0u;
+
+	static const uint SOURCE_IP_SLOTS = 512;
+
+	struct Fragment {
+		std::atomic<char*> data;
+		uint_fast16_t length;
+		bool ownerMayFreeData;
+		uint16_t offset;
+	};
+
+	struct alignas(64) Slot {
+		std::atomic<uint64_t> key;
+		std::atomic<uint> generation;
+
 		/*
-		 * Sort the fragments by offset
+		 * Set while a slot is claimed for a datagram whose first probe position is this slot
 		 */
-		std::sort(fragments.begin(), fragments.end(),
-				[](const DataContainer& a, const DataContainer& b) {
-					UDP_HDR* hdr1 = (UDP_HDR*) a.data;
-					UDP_HDR* hdr2 = (UDP_HDR*) b.data;
-					return hdr1->getFragmentOffsetInBytes() < hdr2->getFragmentOffsetInBytes();
-				});
+		std::atomic<bool> claiming;
 
-		UDP_HDR* lastFragment = (UDP_HDR*) fragments.back().data;
+		/*
+		 * Number of threads currently adding a fragment
+		 */
+		std::atomic<uint> users;
+		std::atomic<uint> numberOfFragments;
 
 		/*
-		 * We'll copy the ethernet and IP header of the first frame plus all IP-Payload of all frames
+		 * Expected payload bytes in the upper and received ones in the lower 32 bit.
+		 * The expected bytes are 0 until the last fragment arrived
 		 */
-		uint_fast16_t totalBytes = sizeof(ether_header)
-				+ lastFragment->getFragmentOffsetInBytes()
-				+ ntohs(lastFragment->ip.tot_len);
-
-		char* newFrameBuff = new char[totalBytes];
-
-		uint_fast16_t currentOffset = sizeof(ether_header) + sizeof(iphdr);
-		for (DataContainer& fragment : fragments) {
-			UDP_HDR* currentData = (UDP_HDR*) fragment.data;
-
-			if (currentData->getFragmentOffsetInBytes() + sizeof(ether_header)
-					+ sizeof(iphdr) != currentOffset) {
-				LOG_ERROR(
-						   "Error while reassembling IP fragments: sum of fragment lengths is "
-						<< currentOffset << " but offset of current frame is "
-						<< currentData->getFragmentOffsetInBytes());
-				return std::move(empty());
-			}
-
-			/*
-			 * Copy the payload of the IP datagram to the buffer
-			 *
-			 * The payload starts after sizeof(ether_header) + sizeof(iphdr) and is ntohs(currentData->ip.tot_len) - sizeof(iphdr) bytes long
-			 */
-			if (&fragment == &fragments.front()) {
-				/*
-				 * First frame is copied entirely
-				 */
-				memcpy(newFrameBuff, fragment.data, fragment.length);
-				currentOffset = fragment.length;
-			} else {
-				memcpy(newFrameBuff + currentOffset,
-						fragment.data + sizeof(ether_header) + sizeof(iphdr),
-						ntohs(currentData->ip.tot_len) - sizeof(iphdr));
-				currentOffset += ntohs(currentData->ip.tot_len) - sizeof(iphdr);
-			}
-		}
-		LOG_INFO("Returning the assembled packet");
-		DataContainer complete_fragment{newFrameBuff, currentOffset, true};
-		return std::move(complete_fragment);
+		std::atomic<uint64_t> bytes;
+
+		Fragment fragments[MAX_FRAGMENTS];
+	};
+
+	static uint numberOfSlots_;
+	static Slot* slots_;
+
+	static std::atomic<uint> numberOfFragmentsReceived_;
+	static std::atomic<uint> numberOfReassembledFrames_;
+	static std::atomic<uint> numberOfDroppedFragments_;
+	static std::atomic<uint> numberOfUnfinishedFrames_;
+
+	static uint timeout_;
+	static std::atomic<uint> generation_;
+	static std::atomic<uint> evictionGeneration_;
+
+	static std::atomic<uint64_t> numberOfStaleFrames_;
+	static std::atomic<uint64_t> numberOfStaleFragments_;
+
+	struct SourceIPFragments {
+		std::atomic<uint32_t> ip;
+		std::atomic<uint64_t> fragments;
+	};
+	static SourceIPFragments staleFragmentsBySourceIP_[SOURCE_IP_SLOTS];
+
+	static inline uint64_t generateFragmentID(const uint_fast32_t srcIP,
+			const uint_fast16_t fragID) {
+		return (uint64_t) fragID | ((uint64_t) srcIP << 16);
 	}
+
+	/**
+	 * Returns the slot of the datagram <fragID> with users incremented or nullptr if the table is full
+	 */
+	static Slot* enterSlot(const uint64_t fragID);
+
+	/**
+	 * Enters the existing slot of the datagram <fragID> or returns nullptr if there is none
+	 */
+	static Slot* findSlot(const uint64_t fragID, const uint firstIndex);
+
+	/**
+	 * Increments the users of <slot> if it still belongs to the datagram <fragID>
+	 */
+	static bool tryEnter(Slot* slot, const uint64_t fragID);
+
+	static void leaveSlot(Slot* slot);
+
+	static DataContainer reassembleFrame(Slot* slot, const uint expectedPayloadBytes);
+
+	static void freeFragment(char* data, uint_fast16_t length, bool ownerMayFreeData);
 };
 
 } /* namespace na62 */
@@ -0,0 +1,23 @@
+/*
+ * FramePool.cpp
+ *
+ *  Created on: Oct 17, 2026
+ */
+
+#include "FramePool.h"
+
+#include <structs/Network.h>
+#include <options/Logging.h>
+
+#include "../options/MyOptions.h"
+
+namespace na62 {
+
+BufferPool FramePool::pool_;
+
+void FramePool::initialize(uint numberOfQueues) {
+	pool_.initialize("Frame", numberOfQueues, MTU, Options::GetInt(OPTION_FRAME_POOL_SIZE),
+			MyOptions::GetBool(OPTION_FRAME_POOL_HUGE_PAGES));
+}
+
+} /* namespace na62 */
@@ -0,0 +1,73 @@
+/*
+ * FramePool.h
+ *
+ * Recycled MTU sized frame buffers for the PacketHandler threads
+ *
+ *  Created on: Oct 17, 2026
+ */
+
+#ifndef FRAMEPOOL_H_
+#define FRAMEPOOL_H_
+
+#include <sys/types.h>
+#include <cstdint>
+
+#include "BufferPool.h"
+
+namespace na62 {
+
+/*
+ * One pool of MTU sized frame buffers per RX queue, see BufferPool.
+ *
+ * Frames are freed by whichever thread is done with them: directly via
+ * BufferPool::free() or by the MEPs created via MEPPool::create(). The buffers
+ * are recognized by their address and returned to the PacketHandler that
+ * received them.
+ */
+class FramePool {
+public:
+	/**
+	 * Reserves the memory of all pools. Must be called before the PacketHandler threads are started
+	 */
+	static void initialize(uint numberOfQueues);
+
+	/**
+	 * Builds the free list of the given queue. Must be called by the PacketHandler of this queue
+	 * after it has been pinned so that the memory is touched first on the local NUMA node
+	 */
+	static inline void initializeQueue(uint queueNum) {
+		pool_.initializeOwner(queueNum);
+	}
+
+	/**
+	 * Returns a buffer of at least <length> bytes. May only be called by the PacketHandler of <queueNum>
+	 */
+	static inline char* allocate(uint queueNum, uint_fast16_t length) {
+		return pool_.allocate(queueNum, length);
+	}
+
+	/*
+	 * Number of times a frame has been allocated on the heap because the pool was empty
+	 */
+	static inline uint64_t getNumberOfExhaustions() {
+		return pool_.getNumberOfExhaustions();
+	}
+
+	/*
+	 * Highest number of buffers in use at the same time in any of the pools
+	 */
+	static inline uint getHighWatermark() {
+		return pool_.getHighWatermark();
+	}
+
+	static inline uint getNumberOfBuffersInUse() {
+		return pool_.getNumberOfBuffersInUse();
+	}
+
+private:
+	static BufferPool pool_;
+};
+
+} /* namespace na62 */
+
+#endif /* FRAMEPOOL_H_ */
@@ -43,10 +43,15 @@
 
 #include "../eventBuilding/L1Builder.h"
 #include "../eventBuilding/L2Builder.h"
+#include "../eventBuilding/EventDispatcher.h"
 #include "../options/MyOptions.h"
 //#include "../straws/StrawReceiver.h"
 #include "PacketHandler.h"
 #include "FragmentStore.h"
+#include "OverloadControl.h"
+#include "ChecksumVerifier.h"
+#include "../utils/RateLimitedLog.h"
+#include "MEPPool.h"
 
 namespace na62 {
 
@@ -58,22 +63,33 @@ uint_fast32_t HandleFrameTask::MyIP;
 std::atomic<uint> HandleFrameTask::queuedTasksNum_;
 uint HandleFrameTask::highestSourceNum_;
 uint HandleFrameTask::highestL1SourceNum_;
-std::atomic<uint64_t>* HandleFrameTask::MEPsReceivedBySourceNum_;
-std::atomic<uint64_t>* HandleFrameTask::BytesReceivedBySourceNum_;
-std::atomic<uint64_t>* HandleFrameTask::L1MEPsReceivedBySourceNum_;
-std::atomic<uint64_t>* HandleFrameTask::L1BytesReceivedBySourceNum_;
-
-HandleFrameTask::HandleFrameTask(std::vector<DataContainer>&& _containers,
-		uint burstID) :
-		containers_(std::move(_containers)), burstID_(burstID) {
-	queuedTasksNum_.fetch_add(1, std::memory_order_relaxed);
+ShardedCounters HandleFrameTask::ReceivedBySourceNum_;
+ShardedCounters HandleFrameTask::L1ReceivedBySourceNum_;
+
+bool HandleFrameTask::batchPrePass_ = true;
+
+HandleFrameTask::VirtualSource HandleFrameTask::virtualSources_[3];
+uint HandleFrameTask::numberOfVirtualSources_ = 0;
+
+HandleFrameTask::HandleFrameTask(uint capacity,
+		tbb::concurrent_queue<HandleFrameTask*>& freeTasks) :
+		burstID_(0), freeTasks_(freeTasks) {
+	containers_.reserve(capacity);
 }
 
 HandleFrameTask::~HandleFrameTask() {
-	queuedTasksNum_.fetch_sub(1, std::memory_order_relaxed);
+}
+
+void HandleFrameTask::recycle() {
+	if (!containers_.empty()) {
+		containers_.clear();
+		queuedTasksNum_.fetch_sub(1, std::memory_order_relaxed);
+	}
+	freeTasks_.push(this);
 }
 
 void HandleFrameTask::initialize() {
+	batchPrePass_ = MyOptions::GetBool(OPTION_BATCH_PRE_PASS);
 	L0_Port = Options::GetInt(OPTION_L0_RECEIVER_PORT);
 	CREAM_Port = Options::GetInt(OPTION_CREAM_RECEIVER_PORT);
 //	STRAW_PORT = Options::GetInt(OPTION_STRAW_PORT);
@@ -84,30 +100,19 @@ void HandleFrameTask::initialize() {
 	 */
 	highestSourceNum_ = SourceIDManager::NUMBER_OF_L0_DATA_SOURCES;
 
-	MEPsReceivedBySourceNum_ = new std::atomic<uint64_t>[highestSourceNum_];
-	BytesReceivedBySourceNum_ =	new std::atomic<uint64_t>[highestSourceNum_];
+	ReceivedBySourceNum_.initialize(2 * highestSourceNum_);
 
 	/*
 	 * All L1 data sources
 	 */
 	highestL1SourceNum_ = SourceIDManager::NUMBER_OF_L1_DATA_SOURCES;
 
-	L1MEPsReceivedBySourceNum_ = new std::atomic<uint64_t>[highestL1SourceNum_];
-	L1BytesReceivedBySourceNum_ = new std::atomic<uint64_t>[highestL1SourceNum_];
-
-	resetCounters();
+	L1ReceivedBySourceNum_.initialize(2 * highestL1SourceNum_);
 }
 
 void HandleFrameTask::resetCounters() {
-	for (uint i = 0; i != highestSourceNum_; i++) {
-		MEPsReceivedBySourceNum_[i] = 0;
-		BytesReceivedBySourceNum_[i] = 0;
-	}
-
-	for (uint i = 0; i != highestL1SourceNum_; i++) {
-		L1MEPsReceivedBySourceNum_[i] = 0;
-		L1BytesReceivedBySourceNum_[i] = 0;
-	}
+	ReceivedBySourceNum_.reset();
+	L1ReceivedBySourceNum_.reset();
 }
 void HandleFrameTask::processARPRequest(ARP_HDR* arp) {
 	/*
@@ -138,13 +143,38 @@ void HandleFrameTask::execute(TaskProcessor* taskProcessor) {
 //		usleep(1);
 //	}
 
-	for (DataContainer& container : containers_) {
-		//If we must clean up the burst we just drop data
-		if(BurstIdHandler::flushBurst()) {
-			LOG_WARNING("Dropping data because we are at EoB Run: " << BurstIdHandler::getRunNumber() << " Burst: " << BurstIdHandler::getCurrentBurstId());
-			container.free();
-		} else {
-			processFrame(std::move(container), taskProcessor);
+	if (!batchPrePass_) {
+		for (DataContainer& container : containers_) {
+			if (!dropAtEOB(container)) {
+				processFrame(std::move(container), taskProcessor);
+			}
+		}
+		return;
+	}
+
+	classifyFrames();
+
+	/*
+	 * CREAM data first as it completes events already waiting in the pool
+	 */
+	for (uint32_t index : frameIndices_[CREAM_FRAME]) {
+		if (!dropAtEOB(containers_[index])) {
+			processGuarded(std::move(containers_[index]), taskProcessor, &HandleFrameTask::processCREAMFrame);
+		}
+	}
+	for (uint32_t index : frameIndices_[L0_FRAME]) {
+		if (!dropAtEOB(containers_[index])) {
+			processGuarded(std::move(containers_[index]), taskProcessor, &HandleFrameTask::processL0Frame);
+		}
+	}
+	for (uint32_t index : frameIndices_[IP_FRAGMENT]) {
+		if (!dropAtEOB(containers_[index])) {
+			processGuarded(std::move(containers_[index]), taskProcessor, &HandleFrameTask::processUDPFrame);
+		}
+	}
+	for (uint32_t index : frameIndices_[OTHER_FRAME]) {
+		if (!dropAtEOB(containers_[index])) {
+			processFrame(std::move(containers_[index]), taskProcessor);
 		}
 	}
 
@@ -155,291 +185,265 @@ void HandleFrameTask::execute(TaskProcessor* taskProcessor) {
 	//return nullptr;
 }
 
-void HandleFrameTask::freeContainer(DataContainer&& container, TaskProcessor* taskProcessor) {
-	if(MyOptions::GetBool(OPTION_DUMP_BAD_PACKETS)){
-		taskProcessor->dumpPacket(container);
+void HandleFrameTask::classifyFrames() {
+	static const uint BLOCK = 16;
+
+	for (auto& indices : frameIndices_) {
+		indices.clear();
 	}
-	container.free();
-}
 
-void HandleFrameTask::processFrame(DataContainer&& container, TaskProcessor* taskProcessor) {
-	UDP_HDR* hdr = (UDP_HDR*) container.data;
-	const uint_fast16_t etherType = /*ntohs*/(hdr->eth.ether_type);
-	const uint_fast8_t ipProto = hdr->ip.protocol;
-	uint_fast16_t destPort = ntohs(hdr->udp.dest);
-	const uint_fast32_t dstIP = hdr->ip.daddr;
+	/*
+	 * All compared in network byte order
+	 */
+	const uint16_t l0Port = htons(L0_Port);
+	const uint16_t creamPort = htons(CREAM_Port);
+	const uint32_t myIP = MyIP;
+	const bool verifyChecksums = ChecksumVerifier::getMode() != CHECKSUM_OFF;
+
+	uint16_t etherType[BLOCK];
+	uint8_t protocol[BLOCK];
+	uint32_t dstIP[BLOCK];
+	uint16_t ipLength[BLOCK];
+	uint16_t udpLength[BLOCK];
+	uint16_t fragment[BLOCK];
+	uint16_t destPort[BLOCK];
+	uint16_t frameLength[BLOCK];
+	uint8_t frameClass[BLOCK];
+
+	const uint numberOfFrames = containers_.size();
+	for (uint first = 0; first < numberOfFrames; first += BLOCK) {
+		const uint count = std::min(BLOCK, numberOfFrames - first);
 
-	try {
 		/*
-		 * Check if we received an ARP request
+		 * The headers are spread over the frame buffers: gather the fields into arrays first
 		 */
-		if (etherType != 0x0008/*ETHERTYPE_IP*/|| ipProto != IPPROTO_UDP) {
-			if (etherType == 0x0608/*ETHERTYPE_ARP*/) {
+		for (uint i = 0; i != count; i++) {
+			const DataContainer& container = containers_[first + i];
+			if (container.length < sizeof(UDP_HDR)) {
 				/*
-				u_int16_t pktLen = container.length;
-				char buff[64];
-				char* pbuff = buff;
-				memcpy(pbuff, container.data, pktLen);
-				std::stringstream AAARP;
-				AAARP << "ARP Request FromRouter" << pktLen << " ";
-				for (int i = 0; i < pktLen; i++)
-					AAARP << std::hex << ((char) (*(pbuff + i)) & 0xFF) << " ";
-				LOG_INFO(AAARP.str());
+				 * No header to gather: every field is read below, so none may be left uninitialized
 				 */
-
-				// this will delete the data
-				processARPRequest(reinterpret_cast<ARP_HDR*>(container.data));
-				return;
-			} else {
-				// Just ignore this frame as it's neither IP nor ARP
-				freeContainer(std::move(container), taskProcessor);
-				return;
+				etherType[i] = 0;
+				protocol[i] = 0;
+				dstIP[i] = 0;
+				ipLength[i] = 0;
+				udpLength[i] = 0;
+				fragment[i] = 0;
+				destPort[i] = 0;
+				frameLength[i] = container.length;
+				continue;
 			}
+			const UDP_HDR* hdr = reinterpret_cast<const UDP_HDR*>(container.data);
+			etherType[i] = hdr->eth.ether_type;
+			protocol[i] = hdr->ip.protocol;
+			dstIP[i] = hdr->ip.daddr;
+			ipLength[i] = hdr->ip.tot_len;
+			udpLength[i] = hdr->udp.len;
+			fragment[i] = hdr->ip.frag_off;
+			destPort[i] = hdr->udp.dest;
+			frameLength[i] = container.length;
 		}
 
 		/*
-		 * Check checksum errors
+		 * Branch free so that the compiler can vectorize it. Same checks as in processFrame and checkFrame,
+		 * everything not passing them is left to processFrame which logs the reason
 		 */
-		if (!checkFrame(hdr, container.length)) {
-			//LOG_ERROR("type = BadPack : Received broken packet from " << EthernetUtils::ipToString(hdr->ip.saddr));
-			freeContainer(std::move(container), taskProcessor);
-			return;
+		for (uint i = 0; i != count; i++) {
+			const bool isUDPForMe = (etherType[i] == 0x0008/*ETHERTYPE_IP*/) & (protocol[i] == IPPROTO_UDP) & (dstIP[i] == myIP);
+			const bool isFragment = (fragment[i] & 0xff3f) != 0;
+			const uint ipBytes = __builtin_bswap16(ipLength[i]) + sizeof(ether_header);
+			const uint udpBytes = __builtin_bswap16(udpLength[i]) + sizeof(ether_header) + sizeof(iphdr);
+			const bool lengthsOK = (ipBytes <= frameLength[i]) & (udpBytes <= frameLength[i]);
+
+			uint8_t cls = OTHER_FRAME;
+			cls = (lengthsOK & (destPort[i] == creamPort)) ? (uint8_t) CREAM_FRAME : cls;
+			cls = (lengthsOK & (destPort[i] == l0Port)) ? (uint8_t) L0_FRAME : cls;
+			cls = isFragment ? (uint8_t) IP_FRAGMENT : cls;
+			frameClass[i] = isUDPForMe ? cls : (uint8_t) OTHER_FRAME;
 		}
 
 		/*
-		 * Check if we are really the destination of the IP datagram
+		 * Frames with bad checksums are left to processFrame which counts them
 		 */
-		if (MyIP != dstIP) {
-		//if("10.194.20.37" != EthernetUtils::ipToString(dstIP)) {
-			LOG_ERROR("type = BadPack : Received packet with wrong destination IP: " << EthernetUtils::ipToString(dstIP) << " from: " << EthernetUtils::ipToString(hdr->ip.saddr));
-			freeContainer(std::move(container), taskProcessor);
-			return;
-		}
-
-		if (hdr->isFragment()) {
-			container = std::move(FragmentStore::addFragment(std::move(container)));
-			if (container.data == nullptr) {
-				return;
+		for (uint i = 0; i != count; i++) {
+			uint8_t cls = frameClass[i];
+			if (verifyChecksums && cls != OTHER_FRAME) {
+				const DataContainer& container = containers_[first + i];
+				if (!ChecksumVerifier::verify(reinterpret_cast<const UDP_HDR*>(container.data), container.length)) {
+					cls = OTHER_FRAME;
+				}
 			}
-			hdr = reinterpret_cast<UDP_HDR*>(container.data);
-			destPort = ntohs(hdr->udp.dest);
+			frameIndices_[cls].push_back(first + i);
 		}
+	}
+}
 
-		const char * UDPPayload = container.data + sizeof(UDP_HDR);
-		const uint_fast16_t & UdpDataLength = ntohs(hdr->udp.len)
-				- sizeof(udphdr);
+bool HandleFrameTask::dropAtEOB(DataContainer& container) {
+	//If we must clean up the burst we just drop data
+	if (BurstIdHandler::flushBurst()) {
+		RateLimitedLog::report(EOB_FRAME_DROPPED, 0, BurstIdHandler::getRunNumber(), BurstIdHandler::getCurrentBurstId());
+		BufferPool::free(container);
+		return true;
+	}
+	return false;
+}
 
-		/*
-		 *  Now let's see what's insight the packet
-		 */
-		if (destPort == L0_Port) { ////////////////////////////////////////////////// L0 Data //////////////////////////////////////////////////
-			/*
-			 * L0 Data
-			 * Length is hdr->ip.tot_len-sizeof(udphdr) and not container.length because of ethernet padding bytes!
-			 */
-			l0::MEP* mep = new l0::MEP(UDPPayload, UdpDataLength, container);
+void HandleFrameTask::freeContainer(DataContainer&& container, TaskProcessor* taskProcessor) {
+	if(MyOptions::GetBool(OPTION_DUMP_BAD_PACKETS)){
+		taskProcessor->dumpPacket(container);
+	}
+	BufferPool::free(container);
+}
 
-			uint sourceNum = SourceIDManager::sourceIDToNum(mep->getSourceID());
+void HandleFrameTask::initializeVirtualSources(uint numberOfTaskProcessors) {
+	const uint eventsPerMEP = Options::GetInt(OPTION_NUMBER_OF_FRAGS_PER_L0MEP);
+	const uint buffersPerTaskProcessor = Options::GetInt(OPTION_VIRTUAL_SOURCE_POOL_SIZE);
 
-			MEPsReceivedBySourceNum_[sourceNum].fetch_add(1,
-					std::memory_order_relaxed);
-			BytesReceivedBySourceNum_[sourceNum].fetch_add(container.length,
-					std::memory_order_relaxed);
+	auto addSource = [&](std::string name, uint_fast8_t sourceID, uint eventLength) {
+		VirtualSource& source = virtualSources_[numberOfVirtualSources_++];
+		source.sourceID = sourceID;
+		source.eventLength = eventLength;
+		source.pool.initialize(name, numberOfTaskProcessors, sizeof(UDP_HDR) + 8 /* mep header */ + eventsPerMEP * eventLength,
+				buffersPerTaskProcessor, false);
+	};
 
-			/*
-			 * Setup L1 block if L1 is active copying informations from L0TP MEps
-			 */
-			if (mep->getSourceID() == SOURCE_ID_L0TP) {
-				if (SourceIDManager::isL1Active()) {
-					//LOG_INFO("Invent L1 MEP for event " << mep->getFirstEventNum());
-					uint16_t mep_factor = mep->getNumberOfFragments();
-					uint16_t fragmentLength = L1TriggerProcessor::GetL1DataPacketSize() + 8; //event length in bytes
-					const uint32_t L1BlockLength = mep_factor * fragmentLength
-							+ 8; //L1 block length in bytes
-					char * L1Data = new char[L1BlockLength + sizeof(UDP_HDR)]; //include UDP header
-					l0::MEP_HDR * L1Hdr = (l0::MEP_HDR *) (L1Data
-							+ sizeof(UDP_HDR));
-
-					// set MEP header
-					L1Hdr->firstEventNum = mep->getFirstEventNum();
-					L1Hdr->sourceID = SOURCE_ID_L1;
-					L1Hdr->mepLength = L1BlockLength;
-					L1Hdr->eventCount = mep_factor;
-					L1Hdr->sourceSubID = 0;
-
-					char * virtualFragment = L1Data + sizeof(UDP_HDR)
-							+ 8 /* mep header */;
-					l0::MEPFragment * L1Fragment;
-					for (uint i = 0; i != mep_factor; i++) {
-						L1Fragment = mep->getFragment(i);
-						// copy the fragment header
-						memcpy(virtualFragment,
-								L1Fragment->getDataWithMepHeader(), 8);
-						uint16_t temp;
-						temp = *(uint16_t *) (virtualFragment) & 0xffff0000;
-						temp |= fragmentLength;
-						*(uint16_t *) (virtualFragment) = temp;
-						virtualFragment += fragmentLength;
-					}
-
-					l0::MEP* mep_L1 = new l0::MEP(L1Data + sizeof(UDP_HDR),
-							L1BlockLength, { L1Data, L1BlockLength, true });
-					uint sourceNum = SourceIDManager::sourceIDToNum(
-							mep_L1->getSourceID());
-
-					MEPsReceivedBySourceNum_[sourceNum].fetch_add(1,
-							std::memory_order_relaxed);
-					BytesReceivedBySourceNum_[sourceNum].fetch_add(
-							L1BlockLength + sizeof(UDP_HDR),
-							std::memory_order_relaxed);
-					for (uint i = 0; i != mep_factor; i++) {
-						// Add every fragment
-						L1Builder::buildEvent(mep_L1->getFragment(i), burstID_, taskProcessor);
-					}
-				}
+	if (SourceIDManager::isL1Active()) {
+		addSource("L1 block", SOURCE_ID_L1, L1TriggerProcessor::GetL1DataPacketSize() + 8);
+	}
+	if (SourceIDManager::isL2Active()) {
+		addSource("L2 block", SOURCE_ID_L2, L2TriggerProcessor::GetL2DataPacketSize() + 8);
+	}
+	if (SourceIDManager::isNSTDActive()) {
+		addSource("NSTD block", SOURCE_ID_NSTD, sizeof(uint32_t) + 8); //dummy length that will be corrected in mergers
+	}
+}
 
-				if (SourceIDManager::isL2Active()) {
-					//LOG_INFO("Invent L2 MEP for event " << mep->getFirstEventNum());
-					uint16_t mep_factor = mep->getNumberOfFragments();
-					uint32_t L2EventLength = L2TriggerProcessor::GetL2DataPacketSize() + 8; //event length in bytes
-					uint32_t L2BlockLength = mep_factor * L2EventLength + 8; //L2 block length in bytes
-					char * L2Data = new char[L2BlockLength + sizeof(UDP_HDR)]; //include UDP header
-					l0::MEP_HDR * L2Hdr = (l0::MEP_HDR *) (L2Data + sizeof(UDP_HDR));
-
-					L2Hdr->firstEventNum = mep->getFirstEventNum();
-					L2Hdr->sourceID = SOURCE_ID_L2;
-					L2Hdr->mepLength = L2BlockLength;
-					L2Hdr->eventCount = mep_factor;
-					L2Hdr->sourceSubID = 0;
-
-					char * L2Event = L2Data + sizeof(UDP_HDR) + 8;
-					l0::MEPFragment * L2Fragment;
-					for (uint i = 0; i != mep_factor; i++) {
-						L2Fragment = mep->getFragment(i);
-						memcpy(L2Event, L2Fragment->getDataWithMepHeader(), 8);
-						uint temp;
-						temp = *(uint *) (L2Event) & 0xffff0000;
-						temp |= L2EventLength;
-						*(uint *) (L2Event) = temp;
-						L2Event += L2EventLength;
-					}
-
-					const uint_fast16_t & L2DataLength = L2BlockLength;
-
-					l0::MEP* mep_L2 = new l0::MEP(L2Data + sizeof(UDP_HDR),
-							L2DataLength, { L2Data, L2DataLength, true });
-					uint sourceNum = SourceIDManager::sourceIDToNum(
-							mep_L2->getSourceID());
-
-					MEPsReceivedBySourceNum_[sourceNum].fetch_add(1,
-							std::memory_order_relaxed);
-					BytesReceivedBySourceNum_[sourceNum].fetch_add(
-							L2BlockLength + sizeof(UDP_HDR),
-							std::memory_order_relaxed);
-
-					for (uint i = 0; i != mep_factor; i++) {
-						// Add every fragment
-						L1Builder::buildEvent(mep_L2->getFragment(i), burstID_, taskProcessor);
-					}
-				}
-				if (SourceIDManager::isNSTDActive()) {
-					//LOG_INFO("Invent NSTD MEP for event " << mep->getFirstEventNum());
-					uint16_t mep_factor = mep->getNumberOfFragments();
-					uint32_t NSTDEventLength = sizeof(uint32_t) + 8; //dummy length that will be corrected in mergers
-					uint32_t NSTDBlockLength = mep_factor * NSTDEventLength + 8; //L2 block length in bytes
-					char * NSTDData =
-							new char[NSTDBlockLength + sizeof(UDP_HDR)]; //include UDP header
-					l0::MEP_HDR * NSTDHdr = (l0::MEP_HDR *) (NSTDData
-							+ sizeof(UDP_HDR));
-
-					NSTDHdr->firstEventNum = mep->getFirstEventNum();
-					NSTDHdr->sourceID = SOURCE_ID_NSTD;
-					NSTDHdr->mepLength = NSTDBlockLength;
-					NSTDHdr->eventCount = mep_factor;
-					NSTDHdr->sourceSubID = 0;
-
-					char * NSTDEvent = NSTDData + sizeof(UDP_HDR) + 8;
-					l0::MEPFragment * NSTDFragment;
-					for (uint i = 0; i != mep_factor; i++) {
-						NSTDFragment = mep->getFragment(i);
-						memcpy(NSTDEvent, NSTDFragment->getDataWithMepHeader(),
-								8);
-						uint temp;
-						temp = *(uint *) (NSTDEvent) & 0xffff0000;
-						temp |= NSTDEventLength;
-						*(uint *) (NSTDEvent) = temp;
-						NSTDEvent += NSTDEventLength;
-					}
-
-					const uint_fast16_t & NSTDDataLength = NSTDBlockLength;
-
-					l0::MEP* mep_NSTD = new l0::MEP(NSTDData + sizeof(UDP_HDR),
-							NSTDDataLength, { NSTDData, NSTDDataLength, true });
-					uint sourceNum = SourceIDManager::sourceIDToNum(
-							mep_NSTD->getSourceID());
-
-					MEPsReceivedBySourceNum_[sourceNum].fetch_add(1,
-							std::memory_order_relaxed);
-					BytesReceivedBySourceNum_[sourceNum].fetch_add(
-							NSTDBlockLength + sizeof(UDP_HDR),
-							std::memory_order_relaxed);
-
-					for (uint i = 0; i != mep_factor; i++) {
-						// Add every fragment
-						L1Builder::buildEvent(mep_NSTD->getFragment(i),
-								burstID_, taskProcessor);
-					}
-				}
-			}
+void HandleFrameTask::initializeVirtualSourcePools(uint taskProcessorID) {
+	for (uint i = 0; i != numberOfVirtualSources_; i++) {
+		virtualSources_[i].pool.initializeOwner(taskProcessorID);
+	}
+}
 
-			uint maxFrags =  mep->getNumberOfFragments();
-			for (uint i = 0; i != maxFrags; i++) {
-				// Add every fragment
-				L1Builder::buildEvent(mep->getFragment(i), burstID_, taskProcessor);
-			}
-		} else if (destPort == CREAM_Port) { ////////////////////////////////////////////////// L1 Data //////////////////////////////////////////////////
-			if (UdpDataLength == 0) {
-				LOG_ERROR("Empty L1 fragment from " << EthernetUtils::ipToString(hdr->ip.saddr));
-				freeContainer(std::move(container), taskProcessor);
-				return;
-			}
-			 l1::MEP* l1mep = new l1::MEP(UDPPayload, UdpDataLength, container);
-
-			//fragment
-			uint sourceNum = SourceIDManager::l1SourceIDToNum(l1mep->getSourceID());
-
-			L1MEPsReceivedBySourceNum_[sourceNum].fetch_add(1,
-					std::memory_order_relaxed);
-			L1BytesReceivedBySourceNum_[sourceNum].fetch_add(container.length,
-					std::memory_order_relaxed);
-
-//			if (EventPool::getPoolSize() > fragment->getEventNumber()) {
-//				EventPool::getCREAMPacketCounter()[fragment->getEventNumber()].fetch_add(
-//						1, std::memory_order_relaxed);
-//			}
-			uint nfrags = l1mep->getNumberOfEvents();
-			for (uint i=0; i!= nfrags ; ++i) {
-				L2Builder::buildEvent(l1mep->getEvent(i));
-			}
-		//} else if (destPort == STRAW_PORT) { ////////////////////////////////////////////////// STRAW Data //////////////////////////////////////////////////
-		//	StrawReceiver::processFrame(std::move(container), burstID_);
-		} else {
+uint64_t HandleFrameTask::getNumberOfVirtualSourcePoolExhaustions() {
+	uint64_t sum = 0;
+	for (uint i = 0; i != numberOfVirtualSources_; i++) {
+		sum += virtualSources_[i].pool.getNumberOfExhaustions();
+	}
+	return sum;
+}
+
+void HandleFrameTask::buildVirtualSource(l0::MEP* l0tpMEP, VirtualSource& source, TaskProcessor* taskProcessor) {
+	//LOG_INFO("Invent MEP of source " << (int) source.sourceID << " for event " << l0tpMEP->getFirstEventNum());
+	const uint16_t mep_factor = l0tpMEP->getNumberOfFragments();
+	const uint32_t blockLength = mep_factor * source.eventLength + 8; //block length in bytes
+
+	/*
+	 * The buffer is returned to the pool by the MEP as soon as all its events have been freed
+	 */
+	char* data = source.pool.allocate(taskProcessor->getId(), blockLength + sizeof(UDP_HDR)); //include UDP header
+	l0::MEP_HDR* mepHdr = (l0::MEP_HDR *) (data + sizeof(UDP_HDR));
+
+	// set MEP header
+	mepHdr->firstEventNum = l0tpMEP->getFirstEventNum();
+	mepHdr->sourceID = source.sourceID;
+	mepHdr->mepLength = blockLength;
+	mepHdr->eventCount = mep_factor;
+	mepHdr->sourceSubID = 0;
+
+	/*
+	 * Every event gets the fragment header of the L0TP with its own event length
+	 */
+	char* virtualFragment = data + sizeof(UDP_HDR) + 8 /* mep header */;
+	for (uint i = 0; i != mep_factor; i++) {
+		memcpy(virtualFragment, l0tpMEP->getFragment(i)->getDataWithMepHeader(), 8);
+		*(uint16_t *) (virtualFragment) = source.eventLength;
+		virtualFragment += source.eventLength;
+	}
+
+	l0::MEP* mep = MEPPool::create<l0::MEP>(taskProcessor->getId(), data + sizeof(UDP_HDR), blockLength,
+			DataContainer { data, (uint_fast16_t) blockLength, true });
+	uint sourceNum = SourceIDManager::sourceIDToNum(mep->getSourceID());
+
+	countReceived(ReceivedBySourceNum_, sourceNum, blockLength + sizeof(UDP_HDR));
+
+	for (uint i = 0; i != mep_factor; i++) {
+		// Add every fragment
+		EventDispatcher::buildL0Event(mep->getFragment(i), burstID_, taskProcessor);
+	}
+}
+
+void HandleFrameTask::processFrame(DataContainer&& container, TaskProcessor* taskProcessor) {
+	UDP_HDR* hdr = (UDP_HDR*) container.data;
+	const uint_fast16_t etherType = /*ntohs*/(hdr->eth.ether_type);
+	const uint_fast8_t ipProto = hdr->ip.protocol;
+	const uint_fast32_t dstIP = hdr->ip.daddr;
+
+	/*
+	 * Check if we received an ARP request
+	 */
+	if (etherType != 0x0008/*ETHERTYPE_IP*/|| ipProto != IPPROTO_UDP) {
+		if (etherType == 0x0608/*ETHERTYPE_ARP*/) {
 			/*
-			 * Packet with unknown UDP port received
+			u_int16_t pktLen = container.length;
+			char buff[64];
+			char* pbuff = buff;
+			memcpy(pbuff, container.data, pktLen);
+			std::stringstream AAARP;
+			AAARP << "ARP Request FromRouter" << pktLen << " ";
+			for (int i = 0; i < pktLen; i++)
+				AAARP << std::hex << ((char) (*(pbuff + i)) & 0xFF) << " ";
+			LOG_INFO(AAARP.str());
 			 */
-			LOG_WARNING("Packet with unknown UDP port received: " << destPort);
+
+			processARPRequest(reinterpret_cast<ARP_HDR*>(container.data));
+			BufferPool::free(container);
+			return;
+		} else {
+			// Just ignore this frame as it's neither IP nor ARP
 			freeContainer(std::move(container), taskProcessor);
 			return;
 		}
+	}
+
+	/*
+	 * Check checksum errors
+	 */
+	if (!checkFrame(hdr, container.length)) {
+		//LOG_ERROR("type = BadPack : Received broken packet from " << EthernetUtils::ipToString(hdr->ip.saddr));
+		freeContainer(std::move(container), taskProcessor);
+		return;
+	}
+
+	/*
+	 * Check if we are really the destination of the IP datagram
+	 */
+	if (MyIP != dstIP) {
+	//if("10.194.20.37" != EthernetUtils::ipToString(dstIP)) {
+		RateLimitedLog::report(WRONG_DESTINATION_IP, hdr->ip.saddr, dstIP);
+		freeContainer(std::move(container), taskProcessor);
+		return;
+	}
+
+	processGuarded(std::move(container), taskProcessor, &HandleFrameTask::processUDPFrame);
+}
+
+void HandleFrameTask::processGuarded(DataContainer&& container, TaskProcessor* taskProcessor,
+		void (HandleFrameTask::*process)(DataContainer&&, TaskProcessor*)) {
+	/*
+	 * Copied as process may replace a fragment by its reassembled datagram and free the fragment
+	 */
+	const uint32_t saddr = ((UDP_HDR*) container.data)->ip.saddr;
+	try {
+		(this->*process)(std::move(container), taskProcessor);
 #ifdef USE_ERS
 	} catch (UnknownSourceID const& e) {
-		LOG_ERROR("Unknown source ID received from " + EthernetUtils::ipToString(hdr->ip.saddr) + ": " + e.message() );
+		RateLimitedLog::report(BAD_DATA, saddr, 0, 0, ("Unknown source ID: " + e.message()).c_str());
 		freeContainer(std::move(container), taskProcessor);
 	} catch (CorruptedMEP const&e) {
-		LOG_ERROR("Corrupted data received from " + EthernetUtils::ipToString(hdr->ip.saddr) + ": " + e.message() );
+		RateLimitedLog::report(BAD_DATA, saddr, 0, 0, ("Corrupted data: " + e.message()).c_str());
 		freeContainer(std::move(container), taskProcessor);
 	} catch (Message const& e) {
-		LOG_ERROR("Bad data received from " + EthernetUtils::ipToString(hdr->ip.saddr) + ": " + e.message() );
+		RateLimitedLog::report(BAD_DATA, saddr, 0, 0, e.message().c_str());
 		freeContainer(std::move(container), taskProcessor);
 	}
 #else
@@ -453,18 +457,106 @@ void HandleFrameTask::processFrame(DataContainer&& container, TaskProcessor* tas
 #endif
 }
 
-bool HandleFrameTask::checkFrame(UDP_HDR* hdr, uint_fast16_t length) {
+void HandleFrameTask::processUDPFrame(DataContainer&& container, TaskProcessor* taskProcessor) {
+	UDP_HDR* hdr = (UDP_HDR*) container.data;
+
+	if (hdr->isFragment()) {
+		container = FragmentStore::addFragment(std::move(container));
+		if (container.data == nullptr) {
+			return;
+		}
+		hdr = reinterpret_cast<UDP_HDR*>(container.data);
+	}
+
 	/*
-	 * Check IP-Header
+	 *  Now let's see what's insight the packet
 	 */
-	//if (!EthernetUtils::CheckData((char*) &hdr->ip, sizeof(iphdr))) {
-	//	LOG_ERROR("Packet with broken IP-checksum received"));
-	//	container.free();
-	//	continue;
-	//}
+	const uint_fast16_t destPort = ntohs(hdr->udp.dest);
+	if (destPort == L0_Port) {
+		processL0Frame(std::move(container), taskProcessor);
+	} else if (destPort == CREAM_Port) {
+		processCREAMFrame(std::move(container), taskProcessor);
+	//} else if (destPort == STRAW_PORT) { ////////////////////////////////////////////////// STRAW Data //////////////////////////////////////////////////
+	//	StrawReceiver::processFrame(std::move(container), burstID_);
+	} else {
+		/*
+		 * Packet with unknown UDP port received
+		 */
+		RateLimitedLog::report(UNKNOWN_UDP_PORT, hdr->ip.saddr, destPort);
+		freeContainer(std::move(container), taskProcessor);
+	}
+}
+
+void HandleFrameTask::processL0Frame(DataContainer&& container, TaskProcessor* taskProcessor) { ////////////////////////////////////////////////// L0 Data //////////////////////////////////////////////////
+	UDP_HDR* hdr = (UDP_HDR*) container.data;
+	const char * UDPPayload = container.data + sizeof(UDP_HDR);
+	const uint_fast16_t & UdpDataLength = ntohs(hdr->udp.len) - sizeof(udphdr);
+
+	/*
+	 * L0 Data
+	 * Length is hdr->ip.tot_len-sizeof(udphdr) and not container.length because of ethernet padding bytes!
+	 */
+	const l0::MEP_HDR* mepHdr = reinterpret_cast<const l0::MEP_HDR*>(UDPPayload);
+	if (!OverloadControl::acceptL0MEP(mepHdr->firstEventNum, mepHdr->eventCount, container.length)) {
+		BufferPool::free(container);
+		return;
+	}
+
+	l0::MEP* mep = MEPPool::create<l0::MEP>(taskProcessor->getId(), UDPPayload, UdpDataLength, container);
+
+	uint sourceNum = SourceIDManager::sourceIDToNum(mep->getSourceID());
+
+	countReceived(ReceivedBySourceNum_, sourceNum, container.length);
+
+	/*
+	 * Setup the L1, L2 and NSTD blocks if active copying informations from L0TP MEPs
+	 */
+	if (mep->getSourceID() == SOURCE_ID_L0TP) {
+		for (uint i = 0; i != numberOfVirtualSources_; i++) {
+			buildVirtualSource(mep, virtualSources_[i], taskProcessor);
+		}
+	}
 
+	uint maxFrags =  mep->getNumberOfFragments();
+	for (uint i = 0; i != maxFrags; i++) {
+		// Add every fragment
+		EventDispatcher::buildL0Event(mep->getFragment(i), burstID_, taskProcessor);
+	}
+}
+
+void HandleFrameTask::processCREAMFrame(DataContainer&& container, TaskProcessor* taskProcessor) { ////////////////////////////////////////////////// L1 Data //////////////////////////////////////////////////
+	UDP_HDR* hdr = (UDP_HDR*) container.data;
+	const char * UDPPayload = container.data + sizeof(UDP_HDR);
+	const uint_fast16_t & UdpDataLength = ntohs(hdr->udp.len) - sizeof(udphdr);
+
+	if (UdpDataLength == 0) {
+		RateLimitedLog::report(EMPTY_L1_MEP, hdr->ip.saddr);
+		freeContainer(std::move(container), taskProcessor);
+		return;
+	}
+	l1::MEP* l1mep = MEPPool::create<l1::MEP>(taskProcessor->getId(), UDPPayload, UdpDataLength, container);
+
+	//fragment
+	uint sourceNum = SourceIDManager::l1SourceIDToNum(l1mep->getSourceID());
+
+	countReceived(L1ReceivedBySourceNum_, sourceNum, container.length);
+
+//	if (EventPool::getPoolSize() > fragment->getEventNumber()) {
+//		EventPool::getCREAMPacketCounter()[fragment->getEventNumber()].fetch_add(
+//				1, std::memory_order_relaxed);
+//	}
+	uint nfrags = l1mep->getNumberOfEvents();
+	for (uint i=0; i!= nfrags ; ++i) {
+		EventDispatcher::buildL1Event(l1mep->getEvent(i), taskProcessor);
+	}
+}
+
+bool HandleFrameTask::checkFrame(UDP_HDR* hdr, uint_fast16_t length) {
+	/*
+	 * The IP header and UDP checksums are verified by the ChecksumVerifier as soon as the lengths are known to be valid
+	 */
 	if (hdr->isFragment()) {
-		return true;
+		return ChecksumVerifier::check(hdr, length);
 	}
 
 	if (ntohs(hdr->ip.tot_len) + sizeof(ether_header) != length) {
@@ -472,9 +564,7 @@ bool HandleFrameTask::checkFrame(UDP_HDR* hdr, uint_fast16_t length) {
 		 * Does not need to be equal because of ethernet padding
 		 */
 		if (ntohs(hdr->ip.tot_len) + sizeof(ether_header) > length) {
-			LOG_ERROR("type = BadPack : check frame failed reason: Received IP-Packet with less bytes than ip.tot_len field! "
-					<< (ntohs(hdr->ip.tot_len) + sizeof(ether_header) ) << "<" << length
-					<< " from: " << EthernetUtils::ipToString(hdr->ip.saddr));
+			RateLimitedLog::report(BAD_IP_LENGTH, hdr->ip.saddr, ntohs(hdr->ip.tot_len) + sizeof(ether_header), length);
 			return false;
 		}
 	}
@@ -483,21 +573,11 @@ bool HandleFrameTask::checkFrame(UDP_HDR* hdr, uint_fast16_t length) {
 	 * Does not need to be equal because of ethernet padding
 	 */
 	if (ntohs(hdr->udp.len) + sizeof(ether_header) + sizeof(iphdr) > length) {
-		LOG_ERROR("type = BadPack : check frame failed reason: Received UDP-Packet with less bytes than udp.len field! "
-				<< (ntohs(hdr->udp.len) + sizeof(ether_header) + sizeof(iphdr)) << "<" <<length
-				<< " from: " << EthernetUtils::ipToString(hdr->ip.saddr));
+		RateLimitedLog::report(BAD_UDP_LENGTH, hdr->ip.saddr, ntohs(hdr->udp.len) + sizeof(ether_header) + sizeof(iphdr), length);
 		return false;
 	}
 
-	/*
-	 * Check UDP checksum
-	 */
-	//if (!EthernetUtils::CheckUDP(hdr, (const char *) (&hdr->udp) + sizeof(udphdr), ntohs(hdr->udp.len) - sizeof(udphdr))) {
-	//	LOG_ERROR("Packet with broken UDP-checksum received" );
-	//	container.free();
-	//	continue;
-	//}
-	return true;
+	return ChecksumVerifier::check(hdr, length);
 }
 
 }
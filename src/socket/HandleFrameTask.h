@@ -11,18 +11,30 @@
 //#include <tbb/task.h>
 #include <cstdint>
 #include <atomic>
+#include <vector>
+#include <tbb/concurrent_queue.h>
 
 #include "TaskProcessor.h"
+#include "BufferPool.h"
+#include "../utils/ShardedCounters.h"
 #include <socket/EthernetUtils.h>
 #include <utils/AExecutable.h>
 
 namespace na62 {
+namespace l0 {
+class MEP;
+}
 
 class HandleFrameTask {
 private:
 
 	std::vector<DataContainer> containers_;
 	uint burstID_;
+
+	/*
+	 * The pool of the PacketHandler this task is recycled to
+	 */
+	tbb::concurrent_queue<HandleFrameTask*>& freeTasks_;
 	void processARPRequest(ARP_HDR* arp);
 
 	/**
@@ -37,25 +49,113 @@ private:
 
 	static std::atomic<uint> queuedTasksNum_;
 
+	/*
+	 * Number of MEPs (2*sourceNum) and bytes (2*sourceNum+1) received per source, not cumulative
+	 */
 	static uint highestSourceNum_;
-	static std::atomic<uint64_t>* MEPsReceivedBySourceNum_;	    //not cumulative
-	static std::atomic<uint64_t>* BytesReceivedBySourceNum_;	//not cumulative
+	static ShardedCounters ReceivedBySourceNum_;
 
 	static uint highestL1SourceNum_;
-	static std::atomic<uint64_t>* L1MEPsReceivedBySourceNum_;	//not cumulative
-	static std::atomic<uint64_t>* L1BytesReceivedBySourceNum_;	//not cumulative
+	static ShardedCounters L1ReceivedBySourceNum_;
+
+	static inline void countReceived(ShardedCounters& counters, uint sourceNum, uint bytes) {
+		counters.increment(2 * sourceNum);
+		counters.add(2 * sourceNum + 1, bytes);
+	}
+
+	/*
+	 * Sources not sent by any detector but created for every L0TP MEP to carry the
+	 * L1, L2 and NSTD results. Their MEPs are built in recycled buffers
+	 */
+	struct VirtualSource {
+		uint_fast8_t sourceID;
+
+		/*
+		 * Length of one event including the 8 B fragment header
+		 */
+		uint eventLength;
+		BufferPool pool;
+	};
+
+	static VirtualSource virtualSources_[3];
+	static uint numberOfVirtualSources_;
+
+	void buildVirtualSource(l0::MEP* l0tpMEP, VirtualSource& source, TaskProcessor* taskProcessor);
+
+	/*
+	 * Classes assigned to the frames of a batch by classifyFrames()
+	 */
+	enum FrameClass : uint8_t {
+		L0_FRAME, CREAM_FRAME, IP_FRAGMENT, OTHER_FRAME, NUMBER_OF_FRAME_CLASSES
+	};
+
+	/*
+	 * Indices into containers_ per class. Kept to reuse the capacity when the task is recycled
+	 */
+	std::vector<uint32_t> frameIndices_[NUMBER_OF_FRAME_CLASSES];
+
+	static bool batchPrePass_;
+
+	/**
+	 * Validates the headers of all frames of the batch at once and fills frameIndices_.
+	 * Only frames passing all checks of processFrame are classified as L0_FRAME or CREAM_FRAME
+	 */
+	void classifyFrames();
+
+	/**
+	 * Frees the frame and returns true if the data of the current burst is being flushed
+	 */
+	bool dropAtEOB(DataContainer& container);
 
 	void processFrame(DataContainer&& container, TaskProcessor* taskProcessor);
+	void processGuarded(DataContainer&& container, TaskProcessor* taskProcessor,
+			void (HandleFrameTask::*process)(DataContainer&&, TaskProcessor*));
+	void processUDPFrame(DataContainer&& container, TaskProcessor* taskProcessor);
+	void processL0Frame(DataContainer&& container, TaskProcessor* taskProcessor);
+	void processCREAMFrame(DataContainer&& container, TaskProcessor* taskProcessor);
 	void freeContainer(DataContainer&& container, TaskProcessor* taskProcessor);
 
 public:
-	HandleFrameTask(std::vector<DataContainer>&& _containers, uint burstID);
+	HandleFrameTask(uint capacity, tbb::concurrent_queue<HandleFrameTask*>& freeTasks);
 	virtual ~HandleFrameTask();
 
+	inline void addFrame(DataContainer&& container) {
+		if (containers_.empty()) {
+			queuedTasksNum_.fetch_add(1, std::memory_order_relaxed);
+		}
+		containers_.push_back(std::move(container));
+	}
+
+	inline bool empty() const {
+		return containers_.empty();
+	}
+
+	inline void setBurstID(uint burstID) {
+		burstID_ = burstID;
+	}
+
 	//tbb::task* execute();
 	void execute(TaskProcessor* taskProcessor);
+
+	/**
+	 * Hands this task back to the PacketHandler that filled it. The frames must have been processed
+	 * already, the capacity of the batch is kept for the next use
+	 */
+	void recycle();
 	static void initialize();
 
+	/**
+	 * Reserves the buffers of the active virtual sources. Must be called before the TaskProcessors are started
+	 */
+	static void initializeVirtualSources(uint numberOfTaskProcessors);
+
+	/**
+	 * Called by every TaskProcessor thread once it has been pinned
+	 */
+	static void initializeVirtualSourcePools(uint taskProcessorID);
+
+	static uint64_t getNumberOfVirtualSourcePoolExhaustions();
+
 	static void resetCounters();
 
 	static inline uint getNumberOfQeuedTasks() {
@@ -63,18 +163,18 @@ public:
 	}
 
 	static inline uint64_t GetMEPsReceivedBySourceNum(uint_fast8_t sourceNum) {
-		return MEPsReceivedBySourceNum_[sourceNum];
+		return ReceivedBySourceNum_.get(2 * sourceNum);
 	}
 
 	static inline uint64_t GetBytesReceivedBySourceNum(uint_fast8_t sourceNum) {
-		return BytesReceivedBySourceNum_[sourceNum];
+		return ReceivedBySourceNum_.get(2 * sourceNum + 1);
 	}
 	static inline uint64_t GetL1MEPsReceivedBySourceNum(uint_fast8_t sourceNum) {
-		return L1MEPsReceivedBySourceNum_[sourceNum];
+		return L1ReceivedBySourceNum_.get(2 * sourceNum);
 	}
 
 	static inline uint64_t GetL1BytesReceivedBySourceNum(uint_fast8_t sourceNum) {
-		return L1BytesReceivedBySourceNum_[sourceNum];
+		return L1ReceivedBySourceNum_.get(2 * sourceNum + 1);
 	}
 };
 
@@ -0,0 +1,32 @@
+/*
+ * IdleWaiter.cpp
+ *
+ *  Created on: Oct 17, 2026
+ */
+
+#include "IdleWaiter.h"
+
+#include <linux/futex.h>
+#include <sys/syscall.h>
+#include <unistd.h>
+#include <ctime>
+
+namespace na62 {
+
+void IdleWaiter::futexWait(uint32_t epoch) {
+	/*
+	 * The timeout makes sure stopped threads and work to be stolen from other queues are noticed
+	 */
+	timespec timeout;
+	timeout.tv_sec = parkTimeoutMicros_ / 1000000;
+	timeout.tv_nsec = (parkTimeoutMicros_ % 1000000) * 1000;
+	syscall(SYS_futex, reinterpret_cast<uint32_t*>(&epoch_), FUTEX_WAIT_PRIVATE, epoch, &timeout, nullptr, 0);
+}
+
+void IdleWaiter::wake(int numberOfThreads) {
+	epoch_.fetch_add(1, std::memory_order_release);
+	wakeups_.fetch_add(1, std::memory_order_relaxed);
+	syscall(SYS_futex, reinterpret_cast<uint32_t*>(&epoch_), FUTEX_WAKE_PRIVATE, numberOfThreads, nullptr, nullptr, 0);
+}
+
+} /* namespace na62 */
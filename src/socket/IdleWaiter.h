@@ -0,0 +1,107 @@
+/*
+ * IdleWaiter.h
+ *
+ * Adaptive wait strategy for consumer threads polling a queue: spin, then
+ * yield and finally park on a futex until a producer wakes the thread up.
+ *
+ *  Created on: Oct 17, 2026
+ */
+
+#ifndef IDLEWAITER_H_
+#define IDLEWAITER_H_
+
+#include <sched.h>
+#include <sys/types.h>
+#include <atomic>
+#include <cstdint>
+
+namespace na62 {
+
+class IdleWaiter {
+public:
+	IdleWaiter() :
+			spins_(1000), yields_(10), parkTimeoutMicros_(10000), epoch_(0), parked_(0), parks_(0), wakeups_(0) {
+	}
+
+	void configure(uint spins, uint yields, uint parkTimeoutMicros) {
+		spins_ = spins;
+		yields_ = yields;
+		parkTimeoutMicros_ = parkTimeoutMicros;
+	}
+
+	/**
+	 * Called by a consumer after every unsuccessful poll with the number of unsuccessful polls in a row.
+	 * Returns as soon as the caller should poll again.
+	 *
+	 * <isReady> must tell without side effects if there is something to poll. It is checked after the
+	 * thread announced that it's going to park so that no wakeup can be lost
+	 */
+	template<typename Ready>
+	inline void idle(uint unsuccessfulPolls, Ready isReady) {
+		if (unsuccessfulPolls < spins_) {
+			cpuRelax();
+		} else if (unsuccessfulPolls < spins_ + yields_) {
+			sched_yield();
+		} else {
+			const uint32_t epoch = epoch_.load(std::memory_order_acquire);
+			parked_.fetch_add(1, std::memory_order_seq_cst);
+			if (!isReady()) {
+				parks_.fetch_add(1, std::memory_order_relaxed);
+				futexWait(epoch);
+			}
+			parked_.fetch_sub(1, std::memory_order_relaxed);
+		}
+	}
+
+	/**
+	 * Called by a producer after pushing: wakes up one parked consumer if there is any
+	 */
+	inline void notifyOne() {
+		std::atomic_thread_fence(std::memory_order_seq_cst);
+		if (parked_.load(std::memory_order_relaxed) != 0) {
+			wake(1);
+		}
+	}
+
+	inline void notifyAll() {
+		std::atomic_thread_fence(std::memory_order_seq_cst);
+		if (parked_.load(std::memory_order_relaxed) != 0) {
+			wake(INT32_MAX);
+		}
+	}
+
+	uint64_t getNumberOfParks() const {
+		return parks_;
+	}
+
+	uint64_t getNumberOfWakeups() const {
+		return wakeups_;
+	}
+
+private:
+	static inline void cpuRelax() {
+#if defined(__x86_64__) || defined(__i386__)
+		__builtin_ia32_pause();
+#endif
+	}
+
+	void futexWait(uint32_t epoch);
+	void wake(int numberOfThreads);
+
+	uint spins_;
+	uint yields_;
+	uint parkTimeoutMicros_;
+
+	/*
+	 * Incremented by every wakeup, this is the futex word
+	 */
+	std::atomic<uint32_t> epoch_;
+	std::atomic<uint> parked_;
+
+	std::atomic<uint64_t> parks_;
+	std::atomic<uint64_t> wakeups_;
+};
+
+} /* namespace na62 */
+
+#endif /* IDLEWAITER_H_ */
@@ -0,0 +1,22 @@
+/*
+ * MEPPool.cpp
+ *
+ *  Created on: Oct 17, 2026
+ */
+
+#include "MEPPool.h"
+
+#include <options/Logging.h>
+
+#include "../options/MyOptions.h"
+
+namespace na62 {
+
+BufferPool MEPPool::pool_;
+std::atomic<uint64_t> MEPPool::exhaustions_(0);
+
+void MEPPool::initialize(uint numberOfTaskProcessors) {
+	pool_.initialize("MEP", numberOfTaskProcessors, SLOT_SIZE, Options::GetInt(OPTION_MEP_POOL_SIZE), false);
+}
+
+} /* namespace na62 */
@@ -0,0 +1,141 @@
+/*
+ * MEPPool.h
+ *
+ * Recycled memory for the l0::MEP and l1::MEP objects created by the TaskProcessors
+ *
+ *  Created on: Oct 17, 2026
+ */
+
+#ifndef MEPPOOL_H_
+#define MEPPOOL_H_
+
+#include <sys/types.h>
+#include <atomic>
+#include <cstdint>
+#include <new>
+#include <type_traits>
+
+#include <structs/DataContainer.h>
+
+#include "BufferPool.h"
+
+namespace na62 {
+
+/*
+ * A MEP deletes itself as soon as all its events have been released, from whichever
+ * thread that happens. The objects are constructed in slots of a BufferPool owned by
+ * the creating TaskProcessor and wrapped in a PooledMEP whose operator delete returns
+ * the slot to that TaskProcessor instead of the heap.
+ *
+ * A MEP frees its frame with DataContainer::free() which knows nothing about pools.
+ * Pooled frames are therefore handed over to the PooledMEP which releases them once
+ * the MEP has been destroyed.
+ */
+class MEPPool {
+public:
+	/**
+	 * Must be called before the TaskProcessors are started
+	 */
+	static void initialize(uint numberOfTaskProcessors);
+
+	/**
+	 * Called by every TaskProcessor thread once it has been pinned
+	 */
+	static inline void initializeTaskProcessor(uint taskProcessorID) {
+		pool_.initializeOwner(taskProcessorID);
+	}
+
+	/**
+	 * Constructs a MEP of the frame <container>. May only be called by the TaskProcessor <taskProcessorID>
+	 */
+	template<typename MEPType>
+	static MEPType* create(uint taskProcessorID, const char* data, uint_fast16_t length, DataContainer container) {
+		static_assert(sizeof(PooledMEP<MEPType>) <= SLOT_SIZE, "MEPPool::SLOT_SIZE is too small");
+		static_assert(std::has_virtual_destructor<MEPType>::value, "MEPs deleting themselves must have a virtual destructor");
+
+		/*
+		 * The MEP must not free a pooled frame itself
+		 */
+		BufferPool* framePool = container.ownerMayFreeData ? BufferPool::getOwningPool(container.data) : nullptr;
+		DataContainer frame { container.data, container.length, container.ownerMayFreeData && framePool == nullptr };
+
+		PooledMEP<MEPType>* mep;
+		char* memory = pool_.tryAllocate(taskProcessorID);
+		if (memory == nullptr) {
+			exhaustions_++;
+			mep = new PooledMEP<MEPType>(data, length, frame);
+		} else {
+			try {
+				mep = new (memory) PooledMEP<MEPType>(data, length, frame);
+			} catch (...) {
+				pool_.release(memory);
+				throw;
+			}
+		}
+
+		/*
+		 * Taken over only now: if the constructor throws the caller still owns the frame
+		 */
+		mep->frame = container.data;
+		mep->framePool = framePool;
+		return mep;
+	}
+
+	/*
+	 * Number of MEPs allocated on the heap because the pool was empty
+	 */
+	static inline uint64_t getNumberOfExhaustions() {
+		return exhaustions_;
+	}
+
+	static inline uint getNumberOfMEPsInUse() {
+		return pool_.getNumberOfBuffersInUse();
+	}
+
+private:
+	static const size_t SLOT_SIZE = 128;
+
+	/*
+	 * Base class destroyed after the MEP: returns the frame to its pool
+	 */
+	struct PooledFrame {
+		PooledFrame() :
+				frame(nullptr), framePool(nullptr) {
+		}
+
+		~PooledFrame() {
+			if (framePool != nullptr) {
+				framePool->release(frame);
+			}
+		}
+
+		char* frame;
+		BufferPool* framePool;
+	};
+
+	template<typename MEPType>
+	class PooledMEP: public PooledFrame, public MEPType {
+	public:
+		PooledMEP(const char* data, uint_fast16_t length, DataContainer& container) :
+				PooledFrame(), MEPType(data, length, container) {
+		}
+
+		/*
+		 * Called via the virtual destructor when the MEP deletes itself
+		 */
+		static void operator delete(void* ptr) {
+			if (pool_.owns(ptr)) {
+				pool_.release(static_cast<char*>(ptr));
+			} else {
+				::operator delete(ptr);
+			}
+		}
+	};
+
+	static BufferPool pool_;
+	static std::atomic<uint64_t> exhaustions_;
+};
+
+} /* namespace na62 */
+
+#endif /* MEPPOOL_H_ */
@@ -0,0 +1,143 @@
+/*
+ * OverloadControl.cpp
+ *
+ *  Created on: Oct 17, 2026
+ */
+
+#include "OverloadControl.h"
+
+#include <options/Logging.h>
+#include <monitoring/BurstIdHandler.h>
+
+#include "../options/MyOptions.h"
+#include "TaskProcessor.h"
+
+namespace na62 {
+
+uint64_t OverloadControl::lowWatermarkFrames_ = 0;
+uint64_t OverloadControl::highWatermarkFrames_ = 0;
+uint64_t OverloadControl::lowWatermarkBytes_ = 0;
+uint64_t OverloadControl::highWatermarkBytes_ = 0;
+uint OverloadControl::eventNumberMargin_ = 0;
+
+std::atomic<uint> OverloadControl::level_(NORMAL);
+std::atomic<uint64_t> OverloadControl::queuedFrames_(0);
+std::atomic<uint64_t> OverloadControl::queuedBytes_(0);
+
+bool OverloadControl::trackEventNumbers_ = false;
+OverloadControl::HighestEventNum OverloadControl::highestEventNums_[MAX_THREADS];
+std::atomic<uint> OverloadControl::nextThreadSlot_(0);
+std::atomic<uint_fast32_t> OverloadControl::dropFromEventNum_(0);
+std::atomic<uint_fast32_t> OverloadControl::dropUntilEventNum_(0);
+
+std::atomic<uint64_t> OverloadControl::droppedFrames_(0);
+std::atomic<uint64_t> OverloadControl::droppedFrameBytes_(0);
+std::atomic<uint64_t> OverloadControl::droppedL0MEPs_(0);
+std::atomic<uint64_t> OverloadControl::droppedL0Bytes_(0);
+std::atomic<uint> OverloadControl::levelEntries_[3];
+
+static const uint_fast32_t NO_EVENT_NUMBER = 0xffffffff;
+
+void OverloadControl::initialize() {
+	lowWatermarkFrames_ = Options::GetInt(OPTION_OVERLOAD_LOW_WATERMARK_FRAMES);
+	highWatermarkFrames_ = Options::GetInt(OPTION_OVERLOAD_HIGH_WATERMARK_FRAMES);
+	lowWatermarkBytes_ = (uint64_t) Options::GetInt(OPTION_OVERLOAD_LOW_WATERMARK_MB) * 1024 * 1024;
+	highWatermarkBytes_ = (uint64_t) Options::GetInt(OPTION_OVERLOAD_HIGH_WATERMARK_MB) * 1024 * 1024;
+	eventNumberMargin_ = Options::GetInt(OPTION_OVERLOAD_EVENT_NUMBER_MARGIN);
+	trackEventNumbers_ = highWatermarkFrames_ != 0 || highWatermarkBytes_ != 0;
+
+	for (auto& highest : highestEventNums_) {
+		highest.value = 0;
+	}
+
+	for (auto& entries : levelEntries_) {
+		entries = 0;
+	}
+}
+
+uint_fast32_t OverloadControl::getHighestEventNum() {
+	uint_fast32_t highestEventNum = 0;
+	for (auto& highest : highestEventNums_) {
+		highestEventNum = std::max(highestEventNum, highest.value.load(std::memory_order_relaxed));
+	}
+	return highestEventNum;
+}
+
+bool OverloadControl::isAbove(uint64_t frames, uint64_t bytes, uint64_t framesWatermark, uint64_t bytesWatermark) {
+	return (framesWatermark != 0 && frames >= framesWatermark) || (bytesWatermark != 0 && bytes >= bytesWatermark);
+}
+
+bool OverloadControl::isBelow(uint64_t frames, uint64_t bytes, uint64_t framesWatermark, uint64_t bytesWatermark) {
+	return (framesWatermark == 0 || frames < framesWatermark * 3 / 4) && (bytesWatermark == 0 || bytes < bytesWatermark * 3 / 4);
+}
+
+void OverloadControl::update() {
+	uint64_t frames = 0;
+	uint64_t bytes = 0;
+	for (uint queue = 0; queue != TaskProcessor::getNumberOfQueues(); queue++) {
+		frames += TaskProcessor::getQueue(queue).getQueuedFrames();
+		bytes += TaskProcessor::getQueue(queue).getQueuedBytes();
+	}
+	queuedFrames_.store(frames, std::memory_order_relaxed);
+	queuedBytes_.store(bytes, std::memory_order_relaxed);
+
+	uint level = level_.load(std::memory_order_relaxed);
+	uint newLevel = NORMAL;
+	if (isAbove(frames, bytes, highWatermarkFrames_, highWatermarkBytes_)
+			|| (level == DROP_L0 && !isBelow(frames, bytes, highWatermarkFrames_, highWatermarkBytes_))) {
+		newLevel = DROP_L0;
+	} else if (isAbove(frames, bytes, lowWatermarkFrames_, lowWatermarkBytes_)
+			|| (level != NORMAL && !isBelow(frames, bytes, lowWatermarkFrames_, lowWatermarkBytes_))) {
+		newLevel = SHED_NON_ESSENTIAL;
+	}
+
+	/*
+	 * Only the thread winning the exchange moves the drop window
+	 */
+	if (newLevel == level || !level_.compare_exchange_strong(level, newLevel)) {
+		return;
+	}
+
+	const uint_fast32_t boundary = getHighestEventNum() + 1 + eventNumberMargin_;
+	if (newLevel == DROP_L0) {
+		dropUntilEventNum_ = NO_EVENT_NUMBER;
+		dropFromEventNum_ = boundary;
+	} else if (level == DROP_L0) {
+		dropUntilEventNum_ = boundary;
+	}
+	levelEntries_[newLevel]++;
+
+	LOG_WARNING("type = Overload : Changed overload level from " << level << " to " << newLevel << " with " << frames << " frames and " << bytes << " B queued");
+}
+
+void OverloadControl::onBurstFinished() {
+	if (droppedFrames_ != 0 || droppedL0MEPs_ != 0) {
+		LOG_ERROR("type = Overload : Dropped " << droppedFrames_ << " non essential frames (" << droppedFrameBytes_ << " B) and "
+				<< droppedL0MEPs_ << " L0 MEPs (" << droppedL0Bytes_ << " B) in burst ID = " << (int) BurstIdHandler::getCurrentBurstId()
+				<< ". Overload level entered " << levelEntries_[SHED_NON_ESSENTIAL] << "/" << levelEntries_[DROP_L0] << " times");
+	}
+
+	droppedFrames_ = 0;
+	droppedFrameBytes_ = 0;
+	droppedL0MEPs_ = 0;
+	droppedL0Bytes_ = 0;
+	for (auto& entries : levelEntries_) {
+		entries = 0;
+	}
+
+	/*
+	 * Event numbers start from 0 again. If we are still overloaded no event of the next burst has been started yet
+	 */
+	for (auto& highest : highestEventNums_) {
+		highest.value = 0;
+	}
+	if (getLevel() == DROP_L0) {
+		dropUntilEventNum_ = NO_EVENT_NUMBER;
+		dropFromEventNum_ = 0;
+	} else {
+		dropFromEventNum_ = 0;
+		dropUntilEventNum_ = 0;
+	}
+}
+
+} /* namespace na62 */
@@ -0,0 +1,168 @@
+/*
+ * OverloadControl.h
+ *
+ * Graded load shedding based on the number of frames and bytes waiting in the task queues
+ *
+ *  Created on: Oct 17, 2026
+ */
+
+#ifndef OVERLOADCONTROL_H_
+#define OVERLOADCONTROL_H_
+
+#include <sys/types.h>
+#include <algorithm>
+#include <atomic>
+#include <cstdint>
+
+namespace na62 {
+
+/*
+ * NORMAL:            Everything is processed
+ * SHED_NON_ESSENTIAL: The queued frames or bytes crossed the low watermark. The PacketHandlers drop
+ *                    all frames which are neither ARP nor sent to the L0 or CREAM port before copying them
+ * DROP_L0:           The queued frames or bytes crossed the high watermark. Additionally L0 MEPs of events
+ *                    which have not been started yet are dropped as a whole by all sources
+ *
+ * A level is left as soon as the queued frames and bytes are below 3/4 of its watermarks.
+ */
+enum OverloadLevel : uint {
+	NORMAL = 0, SHED_NON_ESSENTIAL = 1, DROP_L0 = 2
+};
+
+class OverloadControl {
+public:
+	static void initialize();
+
+	/**
+	 * Recomputes the level from the current queue occupancy. Called by the PacketHandlers after
+	 * every enqueued task and by the monitor
+	 */
+	static void update();
+
+	static inline OverloadLevel getLevel() {
+		return (OverloadLevel) level_.load(std::memory_order_relaxed);
+	}
+
+	static inline void countDroppedFrame(uint length) {
+		droppedFrames_.fetch_add(1, std::memory_order_relaxed);
+		droppedFrameBytes_.fetch_add(length, std::memory_order_relaxed);
+	}
+
+	/**
+	 * Returns false if the L0 MEP starting with <firstEventNum> must be dropped. Events are dropped
+	 * from the first event number after the highest one seen when DROP_L0 was entered up to the one
+	 * after the highest event number seen when it was left so that all sources drop the same events.
+	 */
+	static inline bool acceptL0MEP(uint_fast32_t firstEventNum, uint eventCount, uint length) {
+		if (trackEventNumbers_) {
+			trackEventNumber(firstEventNum + eventCount - 1);
+		}
+
+		if (firstEventNum >= dropFromEventNum_.load(std::memory_order_relaxed)
+				&& firstEventNum < dropUntilEventNum_.load(std::memory_order_relaxed)) {
+			droppedL0MEPs_.fetch_add(1, std::memory_order_relaxed);
+			droppedL0Bytes_.fetch_add(length, std::memory_order_relaxed);
+			return false;
+		}
+		return true;
+	}
+
+	/**
+	 * Logs the actions taken during the last burst and resets all counters and the drop window
+	 */
+	static void onBurstFinished();
+
+	static inline uint64_t getQueuedFrames() {
+		return queuedFrames_;
+	}
+
+	static inline uint64_t getQueuedBytes() {
+		return queuedBytes_;
+	}
+
+	/*
+	 * Per burst counters
+	 */
+	static inline uint64_t getNumberOfDroppedFrames() {
+		return droppedFrames_;
+	}
+
+	static inline uint64_t getNumberOfDroppedL0MEPs() {
+		return droppedL0MEPs_;
+	}
+
+	static inline uint getNumberOfLevelChanges(OverloadLevel level) {
+		return levelEntries_[level];
+	}
+
+private:
+	/*
+	 * Every thread tracks the highest event number it has seen in its own slot, the last one is shared
+	 * by all threads beyond MAX_THREADS
+	 */
+	static const uint MAX_THREADS = 256;
+	static const uint OVERFLOW_SLOT = MAX_THREADS - 1;
+
+	struct alignas(64) HighestEventNum {
+		std::atomic<uint_fast32_t> value;
+	};
+
+	static inline void trackEventNumber(uint_fast32_t eventNum) {
+		static thread_local uint slot = std::min(nextThreadSlot_.fetch_add(1, std::memory_order_relaxed), OVERFLOW_SLOT);
+		std::atomic<uint_fast32_t>& highest = highestEventNums_[slot].value;
+		uint_fast32_t current = highest.load(std::memory_order_relaxed);
+		if (slot != OVERFLOW_SLOT) {
+			if (eventNum > current) {
+				highest.store(eventNum, std::memory_order_relaxed);
+			}
+			return;
+		}
+		while (eventNum > current && !highest.compare_exchange_weak(current, eventNum, std::memory_order_relaxed)) {
+		}
+	}
+
+	/**
+	 * Highest event number seen by any thread
+	 */
+	static uint_fast32_t getHighestEventNum();
+
+	static bool isAbove(uint64_t frames, uint64_t bytes, uint64_t framesWatermark, uint64_t bytesWatermark);
+	static bool isBelow(uint64_t frames, uint64_t bytes, uint64_t framesWatermark, uint64_t bytesWatermark);
+
+	/*
+	 * 0 disables the watermark
+	 */
+	static uint64_t lowWatermarkFrames_;
+	static uint64_t highWatermarkFrames_;
+	static uint64_t lowWatermarkBytes_;
+	static uint64_t highWatermarkBytes_;
+
+	/*
+	 * Number of event numbers, above the highest one seen, which are still accepted once DROP_L0 is
+	 * entered or which are still dropped once it is left. Covers MEPs already being processed
+	 */
+	static uint eventNumberMargin_;
+
+	static std::atomic<uint> level_;
+	static std::atomic<uint64_t> queuedFrames_;
+	static std::atomic<uint64_t> queuedBytes_;
+
+	/*
+	 * Event numbers are only needed to move the drop window, so not tracked without high watermark
+	 */
+	static bool trackEventNumbers_;
+	static HighestEventNum highestEventNums_[MAX_THREADS];
+	static std::atomic<uint> nextThreadSlot_;
+	static std::atomic<uint_fast32_t> dropFromEventNum_;
+	static std::atomic<uint_fast32_t> dropUntilEventNum_;
+
+	static std::atomic<uint64_t> droppedFrames_;
+	static std::atomic<uint64_t> droppedFrameBytes_;
+	static std::atomic<uint64_t> droppedL0MEPs_;
+	static std::atomic<uint64_t> droppedL0Bytes_;
+	static std::atomic<uint> levelEntries_[3];
+};
+
+} /* namespace na62 */
+
+#endif /* OVERLOADCONTROL_H_ */
@@ -23,6 +23,7 @@
 #include <cstring>
 #include <iostream>
 #include <queue>
+#include <sstream>
 #include <thread>
 
 #include <exceptions/UnknownSourceIDFound.h>
@@ -42,6 +43,9 @@
 
 #include "HandleFrameTask.h"
 #include "TaskProcessor.h"
+#include "FramePool.h"
+#include "OverloadControl.h"
+#include "QueueFragmentStore.h"
 
 namespace na62 {
 
@@ -53,10 +57,134 @@ boost::timer::cpu_timer PacketHandler::sendTimer;
 
 std::atomic<uint> PacketHandler::frameHandleTasksSpawned_(0);
 
+uint PacketHandler::numberOfPacketHandlers_ = 0;
+std::atomic<uint64_t>* PacketHandler::batchSizeHistogram_ = nullptr;
+std::atomic<uint64_t>* PacketHandler::batchAgeHistogram_ = nullptr;
+
+void PacketHandler::initialize(uint numberOfPacketHandlers) {
+	numberOfPacketHandlers_ = numberOfPacketHandlers;
+	batchSizeHistogram_ = new std::atomic<uint64_t>[numberOfPacketHandlers * BATCH_HISTOGRAM_BINS] { };
+	batchAgeHistogram_ = new std::atomic<uint64_t>[numberOfPacketHandlers * BATCH_HISTOGRAM_BINS] { };
+	resetBatchHistograms();
+}
+
+void PacketHandler::resetBatchHistograms() {
+	for (uint i = 0; i != numberOfPacketHandlers_ * BATCH_HISTOGRAM_BINS; i++) {
+		batchSizeHistogram_[i] = 0;
+		batchAgeHistogram_[i] = 0;
+	}
+}
+
+static inline uint log2Bin(uint64_t value, uint bins) {
+	uint bin = 63 - __builtin_clzll(value | 1);
+	return bin < bins ? bin : bins - 1;
+}
+
+void PacketHandler::fillBatchHistograms(uint frames, double ageSeconds) {
+	/*
+	 * Only this thread writes to its bins
+	 */
+	std::atomic<uint64_t>& sizeBin = batchSizeHistogram_[threadNum_ * BATCH_HISTOGRAM_BINS + log2Bin(frames, BATCH_HISTOGRAM_BINS)];
+	sizeBin.store(sizeBin.load(std::memory_order_relaxed) + 1, std::memory_order_relaxed);
+
+	std::atomic<uint64_t>& ageBin = batchAgeHistogram_[threadNum_ * BATCH_HISTOGRAM_BINS
+			+ log2Bin(ageSeconds * 1E6, BATCH_HISTOGRAM_BINS)];
+	ageBin.store(ageBin.load(std::memory_order_relaxed) + 1, std::memory_order_relaxed);
+}
+
+static std::string serializeHistogram(std::atomic<uint64_t>* histogram, uint numberOfThreads, uint bins) {
+	std::stringstream stream;
+	for (uint thread = 0; thread != numberOfThreads; thread++) {
+		for (uint bin = 0; bin != bins; bin++) {
+			uint64_t entries = histogram[thread * bins + bin];
+			if (entries > 0) {
+				stream << thread << "," << bin << "," << entries << ";";
+			}
+		}
+	}
+	return stream.str();
+}
+
+std::string PacketHandler::serializeBatchSizeHistogram() {
+	return serializeHistogram(batchSizeHistogram_, numberOfPacketHandlers_, BATCH_HISTOGRAM_BINS);
+}
+
+std::string PacketHandler::serializeBatchAgeHistogram() {
+	return serializeHistogram(batchAgeHistogram_, numberOfPacketHandlers_, BATCH_HISTOGRAM_BINS);
+}
+
 PacketHandler::PacketHandler(int threadNum) :
-		threadNum_(threadNum), running_(true) {}
+		threadNum_(threadNum), running_(true), taskCapacity_(
+				std::min(Options::GetInt(OPTION_MAX_FRAME_AGGREGATION), Options::GetInt(OPTION_TASK_INITIAL_CAPACITY))), l0Port_(
+				Options::GetInt(OPTION_L0_RECEIVER_PORT)), creamPort_(Options::GetInt(OPTION_CREAM_RECEIVER_PORT)), creamLaneEnabled_(
+				Options::GetInt(OPTION_CREAM_LANE_WEIGHT) != 0), reassembleFragments_(QueueFragmentStore::isEnabled()) {
+}
 
 PacketHandler::~PacketHandler() {
+	HandleFrameTask* task;
+	while (freeTasks_.try_pop(task)) {
+		delete task;
+	}
+}
+
+HandleFrameTask* PacketHandler::getFreeTask() {
+	HandleFrameTask* task;
+	if (freeTasks_.try_pop(task)) {
+		return task;
+	}
+	/*
+	 * Only happens until enough tasks are in flight to cover the queue depth
+	 */
+	return new HandleFrameTask(taskCapacity_, freeTasks_);
+}
+
+TaskLane PacketHandler::classifyFrame(char* frame, uint length, bool& essential) {
+	essential = true;
+	if (length < sizeof(UDP_HDR)) {
+		return L0_LANE;
+	}
+	UDP_HDR* hdr = reinterpret_cast<UDP_HDR*>(frame);
+	if (hdr->eth.ether_type != 0x0008/*ETHERTYPE_IP*/ || hdr->ip.protocol != IPPROTO_UDP) {
+		essential = hdr->eth.ether_type == 0x0608/*ETHERTYPE_ARP*/;
+		return L0_LANE;
+	}
+	/*
+	 * Only the first IP fragment carries the UDP header
+	 */
+	if (hdr->isFragment() && hdr->getFragmentOffsetInBytes() != 0) {
+		return L0_LANE;
+	}
+	const uint_fast16_t destPort = ntohs(hdr->udp.dest);
+	essential = destPort == l0Port_ || destPort == creamPort_;
+	return creamLaneEnabled_ && destPort == creamPort_ ? CREAM_LANE : L0_LANE;
+}
+
+bool PacketHandler::isIPFragment(char* frame, uint length) {
+	if (length < sizeof(UDP_HDR)) {
+		return false;
+	}
+	UDP_HDR* hdr = reinterpret_cast<UDP_HDR*>(frame);
+	return hdr->eth.ether_type == 0x0008/*ETHERTYPE_IP*/ && hdr->ip.protocol == IPPROTO_UDP && hdr->isFragment();
+}
+
+void PacketHandler::enqueueBatch(Batch& batch, TaskLane lane) {
+	fillBatchHistograms(batch.frames, (tbb::tick_count::now() - batch.firstFrameTime).seconds());
+
+	/*
+	 * Enqueue the task which will check the frame
+	 *
+	 */
+	//HandleFrameTask* task =
+	//		new (tbb::task::allocate_root()) HandleFrameTask(
+	//				std::move(frames), BurstIdHandler::getCurrentBurstId());
+	//tbb::task::enqueue(*task, tbb::priority_t::priority_normal);
+
+	batch.task->setBurstID(BurstIdHandler::getCurrentBurstId());
+	TaskProcessor::getQueue(threadNum_).push(batch.task, lane, batch.frames, batch.bytes);
+	batch.task = nullptr;
+	frameHandleTasksSpawned_++;
+
+	OverloadControl::update();
 }
 
 void PacketHandler::thread() {
@@ -67,38 +195,59 @@ void PacketHandler::thread() {
 	const bool activePolling = Options::GetBool(OPTION_ACTIVE_POLLING);
 	//const uint pollDelay = Options::GetDouble(OPTION_POLLING_DELAY);
 
-	//const uint maxAggregationMicros = Options::GetInt(
-	//OPTION_MAX_AGGREGATION_TIME);
-
 	//const uint minUsecBetweenL1Requests = Options::GetInt(
 	//OPTION_MIN_USEC_BETWEEN_L1_REQUESTS);
 
 	uint sleepMicros = Options::GetInt(OPTION_POLLING_SLEEP_MICROS);
 
+	/*
+	 * A task is enqueued as soon as any of these limits is reached. 0 disables the byte and time limits
+	 */
 	const uint framesToBeGathered = Options::GetInt(OPTION_MAX_FRAME_AGGREGATION);
+	const uint maxAggregationBytes = Options::GetInt(OPTION_MAX_AGGREGATION_BYTES);
+	const double maxAggregationSeconds = Options::GetInt(OPTION_MAX_AGGREGATION_TIME) * 1E-6;
+
+	/*
+	 * This thread is already pinned: the pool memory will be local
+	 */
+	FramePool::initializeQueue(threadNum_);
+	if (reassembleFragments_) {
+		QueueFragmentStore::initializeQueue(threadNum_);
+	}
+
+	Batch batches[NUMBER_OF_LANES];
+	for (Batch& batch : batches) {
+		batch.task = nullptr;
+	}
 
-	sleepMicros = Options::GetInt(OPTION_POLLING_SLEEP_MICROS);
 	char* buff; // = new char[MTU];
 	while (running_) {
 		/*
 		 * We want to aggregate several frames if we already have more HandleFrameTasks running than there are CPU cores available
+		 * The task of a lane is only taken from the pool once the first frame of that lane has been received
 		 */
-		std::vector<DataContainer> frames;
-		frames.reserve(framesToBeGathered);
+		if (reassembleFragments_) {
+			QueueFragmentStore::evictStaleFrames(threadNum_);
+		}
 
 		receivedFrame = 0;
 		buff = nullptr;
 		bool goToSleep = false;
+		bool enqueued = false;
 
 		//uint spinsInARow = 0;
 
-		boost::timer::cpu_timer aggregationTimer;
-
 		/*
-		 * Try to receive [framesToBeCollected] frames
+		 * Without any frame give up after [framesToBeGathered] unsuccessful polls
 		 */
-		for (uint stepNum = 0; stepNum != framesToBeGathered; stepNum++) {
+		for (uint stepNum = 0; batches[CREAM_LANE].task != nullptr || batches[L0_LANE].task != nullptr || stepNum != framesToBeGathered;
+				stepNum++) {
 			if (!running_) {
+				for (Batch& batch : batches) {
+					if (batch.task != nullptr) {
+						batch.task->recycle();
+					}
+				}
 				goto finish;
 			}
 			/*
@@ -118,11 +267,49 @@ void PacketHandler::thread() {
 						LOG_ERROR("Received packet from network with size " << hdr.len << ". Dropping it");
 					}
 					else {
-						char* data = new char[hdr.len];
-						memcpy(data, buff, hdr.len);
-						frames.push_back( { data, (uint_fast16_t) hdr.len, true });
-						goToSleep = false;
-						//spinsInARow = 0;
+						bool essential;
+						TaskLane lane = L0_LANE;
+						DataContainer frame { nullptr, 0, true };
+						if (reassembleFragments_ && isIPFragment(buff, hdr.len)) {
+							/*
+							 * Only complete datagrams are passed on. They may be dropped under overload after reassembly
+							 */
+							frame = QueueFragmentStore::addFragment(threadNum_, buff, hdr.len);
+							if (frame.data != nullptr) {
+								lane = classifyFrame(frame.data, frame.length, essential);
+								if (!essential && OverloadControl::getLevel() != NORMAL) {
+									OverloadControl::countDroppedFrame(frame.length);
+									BufferPool::free(frame);
+								}
+							}
+						} else {
+							lane = classifyFrame(buff, hdr.len, essential);
+							if (!essential && OverloadControl::getLevel() != NORMAL) {
+								/*
+								 * Overloaded: drop it before it is copied
+								 */
+								OverloadControl::countDroppedFrame(hdr.len);
+							} else {
+								frame.data = FramePool::allocate(threadNum_, hdr.len);
+								frame.length = hdr.len;
+								memcpy(frame.data, buff, hdr.len);
+							}
+						}
+
+						if (frame.data != nullptr) {
+							Batch& batch = batches[lane];
+							if (batch.task == nullptr) {
+								batch.task = getFreeTask();
+								batch.frames = 0;
+								batch.bytes = 0;
+								batch.firstFrameTime = tbb::tick_count::now();
+							}
+							batch.bytes += frame.length;
+							batch.task->addFrame(std::move(frame));
+							batch.frames++;
+							goToSleep = false;
+							//spinsInARow = 0;
+						}
 					}
 				}
 				//else {
@@ -134,27 +321,32 @@ void PacketHandler::thread() {
 				NetworkHandler::DoSendQueuedFrames(threadNum_);
 			}
 
-		}
-		if (!frames.empty()) {
+			/*
+			 * Reading the clock is more expensive than a poll: only do it every 16 steps
+			 */
+			const bool checkTime = maxAggregationSeconds != 0 && (stepNum & 0xf) == 0;
 
 			/*
-			 * Start a new task which will check the frame
-			 *
+			 * Without time limit open batches are closed after [framesToBeGathered] polls like without any frame
 			 */
-			//HandleFrameTask* task =
-			//		new (tbb::task::allocate_root()) HandleFrameTask(
-			//				std::move(frames), BurstIdHandler::getCurrentBurstId());
-			//tbb::task::enqueue(*task, tbb::priority_t::priority_normal);
-
-			HandleFrameTask* task = new HandleFrameTask(std::move(frames), BurstIdHandler::getCurrentBurstId());
-			TaskProcessor::TasksQueue_.push(task);
-			int queueSize = TaskProcessor::getSize();
-			if(queueSize >0 && (queueSize%100 == 0)) {
-				LOG_WARNING("Tasks queue size " << (int) queueSize);
+			const bool lastStep = maxAggregationSeconds == 0 && stepNum + 1 >= framesToBeGathered;
+			for (uint lane = 0; lane != NUMBER_OF_LANES; lane++) {
+				Batch& batch = batches[lane];
+				if (batch.task == nullptr) {
+					continue;
+				}
+				if (lastStep || batch.frames >= framesToBeGathered || (maxAggregationBytes != 0 && batch.bytes >= maxAggregationBytes)
+						|| (checkTime && (tbb::tick_count::now() - batch.firstFrameTime).seconds() >= maxAggregationSeconds)) {
+					enqueueBatch(batch, (TaskLane) lane);
+					enqueued = true;
+				}
 			}
-			goToSleep = false;
-			frameHandleTasksSpawned_++;
-		} else {
+			if (enqueued && batches[CREAM_LANE].task == nullptr && batches[L0_LANE].task == nullptr) {
+				break;
+			}
+		}
+
+		if (!enqueued) {
 			goToSleep = true;
 		}
 
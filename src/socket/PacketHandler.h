@@ -13,20 +13,31 @@
 #include <atomic>
 #include <cstdint>
 #include <vector>
+#include <string>
 #include <iostream>
 #include <utils/AExecutable.h>
 #include <boost/timer/timer.hpp>
+#include <tbb/concurrent_queue.h>
 #include <eventBuilding/EventPool.h>
 #include <eventBuilding/Event.h>
+#include <tbb/tick_count.h>
+
+#include "TaskQueue.h"
 
 namespace na62 {
 struct DataContainer;
+class HandleFrameTask;
 
 class PacketHandler: public AExecutable {
 public:
 	PacketHandler(int threadNum);
 	virtual ~PacketHandler();
 
+	/**
+	 * Allocates the statistics of all PacketHandlers. Must be called before the first one is started
+	 */
+	static void initialize(uint numberOfPacketHandlers);
+
 	void stopRunning() {
 		running_ = false;
 	}
@@ -40,10 +51,67 @@ public:
 	 */
 	static std::atomic<uint> frameHandleTasksSpawned_;
 
+	/*
+	 * Histograms of the number of frames per task and of the time between the first frame of a task
+	 * and its enqueueing in microseconds. Bins are log2 of the value, format is "thread,bin,entries;"
+	 */
+	static const uint BATCH_HISTOGRAM_BINS = 32;
+	static std::string serializeBatchSizeHistogram();
+	static std::string serializeBatchAgeHistogram();
+	static void resetBatchHistograms();
+
 private:
 	int threadNum_;
 	bool running_;
 
+	/*
+	 * Tasks handed back by the TaskProcessors after execution
+	 */
+	tbb::concurrent_queue<HandleFrameTask*> freeTasks_;
+	uint taskCapacity_;
+
+	HandleFrameTask* getFreeTask();
+
+	/*
+	 * The frames of one lane aggregated since the last task has been enqueued
+	 */
+	struct Batch {
+		HandleFrameTask* task;
+		uint frames;
+		uint bytes;
+		tbb::tick_count firstFrameTime;
+	};
+
+	uint_fast16_t l0Port_;
+	uint_fast16_t creamPort_;
+
+	/*
+	 * Frames sent to the CREAM port are put into the priority lane
+	 */
+	bool creamLaneEnabled_;
+
+	/**
+	 * Returns the lane the frame should be processed in according to its UDP destination port.
+	 * <essential> is set to false for frames that may be dropped under overload: everything but
+	 * ARP and frames sent to the L0 or CREAM port
+	 */
+	TaskLane classifyFrame(char* frame, uint length, bool& essential);
+
+	/*
+	 * Fragments are reassembled by this thread (see QueueFragmentStore) instead of the TaskProcessors
+	 */
+	bool reassembleFragments_;
+
+	static bool isIPFragment(char* frame, uint length);
+
+	void enqueueBatch(Batch& batch, TaskLane lane);
+
+	static uint numberOfPacketHandlers_;
+	static std::atomic<uint64_t>* batchSizeHistogram_;
+	static std::atomic<uint64_t>* batchAgeHistogram_;
+
+	void fillBatchHistograms(uint frames, double ageSeconds);
+
 	/**
 	 * @return <true> In case of success, false in case of a serious error (we should stop the thread in this case)
 	 */
@@ -0,0 +1,276 @@
+/*
+ * QueueFragmentStore.cpp
+ *
+ *  Created on: Oct 17, 2026
+ */
+
+#include "QueueFragmentStore.h"
+
+#include <algorithm>
+#include <cstdlib>
+#include <cstring>
+#include <new>
+
+#include <options/Logging.h>
+
+#include "../options/MyOptions.h"
+#include "../utils/RateLimitedLog.h"
+#include "ChecksumVerifier.h"
+
+namespace na62 {
+
+uint QueueFragmentStore::numberOfQueues_ = 0;
+uint QueueFragmentStore::slotsPerQueue_ = 0;
+QueueFragmentStore::Queue* QueueFragmentStore::queues_ = nullptr;
+BufferPool QueueFragmentStore::datagramPool_;
+
+void QueueFragmentStore::initialize(uint numberOfQueues) {
+	if (!Options::GetBool(OPTION_REASSEMBLE_IN_PACKET_HANDLER)) {
+		return;
+	}
+
+	/*
+	 * The datagrams are distributed over the queues: every queue gets its share of fragmentTableSize
+	 */
+	const uint requestedSlots = std::max(Options::GetInt(OPTION_FRAGMENT_TABLE_SIZE) / (int) numberOfQueues, (int) MAX_PROBES);
+	slotsPerQueue_ = 1;
+	while (slotsPerQueue_ < requestedSlots) {
+		slotsPerQueue_ <<= 1;
+	}
+
+	numberOfQueues_ = numberOfQueues;
+	queues_ = new Queue[numberOfQueues];
+	for (uint i = 0; i != numberOfQueues; i++) {
+		queues_[i].slots = nullptr;
+		queues_[i].evictionGeneration = 0;
+		queues_[i].fragmentsReceived = 0;
+		queues_[i].reassembledFrames = 0;
+		queues_[i].unfinishedFrames = 0;
+		queues_[i].droppedFragments = 0;
+	}
+	LOG_INFO("Reassembling IP fragments in the PacketHandlers: " << slotsPerQueue_ << " datagrams per queue");
+
+	datagramPool_.initialize("Datagram", numberOfQueues, HEADER_BYTES + MAX_PAYLOAD_BYTES,
+			std::min(slotsPerQueue_, POOLED_DATAGRAMS_PER_QUEUE), MyOptions::GetBool(OPTION_FRAME_POOL_HUGE_PAGES));
+}
+
+void QueueFragmentStore::initializeQueue(uint queueNum) {
+	void* memory;
+	if (posix_memalign(&memory, 64, slotsPerQueue_ * sizeof(Slot)) != 0) {
+		throw std::bad_alloc();
+	}
+	Slot* slots = reinterpret_cast<Slot*>(memory);
+	for (uint i = 0; i != slotsPerQueue_; i++) {
+		slots[i].key = FREE;
+		slots[i].datagram = nullptr;
+		slots[i].numberOfFragments = 0;
+		slots[i].expectedPayloadBytes = 0;
+		slots[i].receivedPayloadBytes = 0;
+	}
+	queues_[queueNum].slots = slots;
+	datagramPool_.initializeOwner(queueNum);
+}
+
+DataContainer QueueFragmentStore::addFragment(uint queueNum, const char* frame, uint length) {
+	Queue& queue = queues_[queueNum];
+	const UDP_HDR* hdr = (const UDP_HDR*) frame;
+	const uint64_t fragID = (uint64_t) hdr->ip.id | ((uint64_t) hdr->ip.saddr << 16);
+	increment(queue.fragmentsReceived);
+
+	const uint totalLength = ntohs(hdr->ip.tot_len);
+	if (totalLength < sizeof(iphdr) || totalLength + sizeof(ether_header) > length) {
+		RateLimitedLog::report(BAD_IP_FRAGMENTS, hdr->ip.saddr, ntohs(hdr->ip.id), 0, "ip.tot_len does not match the frame length");
+		increment(queue.droppedFragments);
+		return DataContainer { nullptr, 0, false };
+	}
+
+	const uint payloadBytes = totalLength - sizeof(iphdr);
+	const uint offset = hdr->getFragmentOffsetInBytes();
+	if (offset + payloadBytes > MAX_PAYLOAD_BYTES) {
+		RateLimitedLog::report(BAD_IP_FRAGMENTS, hdr->ip.saddr, ntohs(hdr->ip.id), offset, "Fragment exceeds the maximum datagram size");
+		increment(queue.droppedFragments);
+		return DataContainer { nullptr, 0, false };
+	}
+
+	Slot* slot = findSlot(queue, fragID);
+	if (slot == nullptr) {
+		RateLimitedLog::report(BAD_IP_FRAGMENTS, hdr->ip.saddr, ntohs(hdr->ip.id), 0, "Fragment table full");
+		increment(queue.droppedFragments);
+		return DataContainer { nullptr, 0, false };
+	}
+	if (slot->datagram == nullptr) {
+		slot->datagram = datagramPool_.allocate(queueNum, HEADER_BYTES + MAX_PAYLOAD_BYTES);
+	}
+
+	if (slot->numberOfFragments == MAX_FRAGMENTS) {
+		RateLimitedLog::report(BAD_IP_FRAGMENTS, hdr->ip.saddr, ntohs(hdr->ip.id), 0, "Too many fragments");
+		increment(queue.droppedFragments);
+		return DataContainer { nullptr, 0, false };
+	}
+
+	if (!hdr->isMoreFragments()) {
+		if (slot->expectedPayloadBytes != 0) {
+			RateLimitedLog::report(BAD_IP_FRAGMENTS, hdr->ip.saddr, ntohs(hdr->ip.id), 0, "Too many last fragments");
+			increment(queue.droppedFragments, slot->numberOfFragments + 1);
+			releaseSlot(queue, slot);
+			return DataContainer { nullptr, 0, false };
+		}
+		slot->expectedPayloadBytes = offset + payloadBytes;
+	}
+
+	/*
+	 * The headers of the first fragment become the headers of the datagram
+	 */
+	if (offset == 0) {
+		memcpy(slot->datagram, frame, HEADER_BYTES);
+	}
+	memcpy(slot->datagram + HEADER_BYTES + offset, frame + HEADER_BYTES, payloadBytes);
+
+	Extent& extent = slot->extents[slot->numberOfFragments++];
+	extent.offset = offset;
+	extent.length = payloadBytes;
+	slot->receivedPayloadBytes += payloadBytes;
+
+	if (slot->expectedPayloadBytes == 0 || slot->receivedPayloadBytes != slot->expectedPayloadBytes) {
+		return DataContainer { nullptr, 0, false };
+	}
+
+	DataContainer reassembledFrame = completeFrame(queue, slot);
+	releaseSlot(queue, slot);
+	return reassembledFrame;
+}
+
+QueueFragmentStore::Slot* QueueFragmentStore::findSlot(Queue& queue, const uint64_t fragID) {
+	const uint mask = slotsPerQueue_ - 1;
+	const uint firstIndex = (fragID * 0x9E3779B97F4A7C15ull) >> 32;
+
+	Slot* freeSlot = nullptr;
+	for (uint probe = 0; probe != MAX_PROBES; probe++) {
+		Slot* slot = &queue.slots[(firstIndex + probe) & mask];
+		if (slot->key == fragID) {
+			return slot;
+		}
+		if (slot->key == FREE && freeSlot == nullptr) {
+			freeSlot = slot;
+		}
+	}
+
+	if (freeSlot != nullptr) {
+		freeSlot->key = fragID;
+		freeSlot->generation = FragmentStore::getGeneration();
+		increment(queue.unfinishedFrames);
+	}
+	return freeSlot;
+}
+
+void QueueFragmentStore::releaseSlot(Queue& queue, Slot* slot) {
+	if (slot->datagram != nullptr && !BufferPool::releaseToOwningPool(slot->datagram)) {
+		delete[] slot->datagram;
+	}
+	slot->key = FREE;
+	slot->datagram = nullptr;
+	slot->numberOfFragments = 0;
+	slot->expectedPayloadBytes = 0;
+	slot->receivedPayloadBytes = 0;
+	increment(queue.unfinishedFrames, -1);
+}
+
+void QueueFragmentStore::evictSlots(Queue& queue, const uint evictionGeneration) {
+	for (uint i = 0; i != slotsPerQueue_; i++) {
+		Slot* slot = &queue.slots[i];
+		if (slot->key == FREE || slot->generation >= evictionGeneration) {
+			continue;
+		}
+		FragmentStore::countStaleFrame(slot->key >> 16, slot->numberOfFragments);
+		RateLimitedLog::report(STALE_IP_FRAGMENTS, slot->key >> 16, ntohs(slot->key & 0xffff), slot->numberOfFragments);
+		releaseSlot(queue, slot);
+	}
+}
+
+DataContainer QueueFragmentStore::completeFrame(Queue& queue, Slot* slot) {
+	/*
+	 * Sort the extents by offset
+	 */
+	Extent* extents = slot->extents;
+	for (uint i = 1; i != slot->numberOfFragments; i++) {
+		const Extent extent = extents[i];
+		uint position = i;
+		while (position != 0 && extents[position - 1].offset > extent.offset) {
+			extents[position] = extents[position - 1];
+			position--;
+		}
+		extents[position] = extent;
+	}
+
+	/*
+	 * As many bytes as expected have been received: any gap implies an overlap
+	 */
+	uint currentOffset = 0;
+	for (uint i = 0; i != slot->numberOfFragments; i++) {
+		if (extents[i].offset != currentOffset) {
+			/*
+			 * The headers may be missing: take the source and the IP id from the key
+			 */
+			RateLimitedLog::report(BAD_IP_FRAGMENTS, slot->key >> 16, ntohs(slot->key & 0xffff), currentOffset,
+					"Sum of fragment lengths does not match the offset of the next fragment");
+			increment(queue.droppedFragments, slot->numberOfFragments);
+			return DataContainer { nullptr, 0, false };
+		}
+		currentOffset += extents[i].length;
+	}
+
+	/*
+	 * The frame is handled like an unfragmented one by the TaskProcessors: clear the offset and the
+	 * more fragments flag (keep don't fragment) and fix the length and the header checksum
+	 */
+	UDP_HDR* hdr = (UDP_HDR*) slot->datagram;
+	hdr->ip.frag_off &= htons(0x4000);
+	hdr->ip.tot_len = htons(sizeof(iphdr) + slot->expectedPayloadBytes);
+	hdr->ip.check = 0;
+	hdr->ip.check = ~ChecksumVerifier::sum(reinterpret_cast<const char*>(&hdr->ip), sizeof(iphdr));
+
+	const uint_fast32_t totalBytes = HEADER_BYTES + slot->expectedPayloadBytes;
+	increment(queue.reassembledFrames);
+	RateLimitedLog::report(IP_FRAME_REASSEMBLED, hdr->ip.saddr, ntohs(hdr->ip.id), totalBytes);
+
+	/*
+	 * Passed on: releaseSlot must not free it
+	 */
+	DataContainer frame { slot->datagram, (uint_fast16_t) totalBytes, true };
+	slot->datagram = nullptr;
+	return frame;
+}
+
+uint QueueFragmentStore::getNumberOfReceivedFragments() {
+	uint sum = 0;
+	for (uint i = 0; i != numberOfQueues_; i++) {
+		sum += queues_[i].fragmentsReceived.load(std::memory_order_relaxed);
+	}
+	return sum;
+}
+
+uint QueueFragmentStore::getNumberOfReassembledFrames() {
+	uint sum = 0;
+	for (uint i = 0; i != numberOfQueues_; i++) {
+		sum += queues_[i].reassembledFrames.load(std::memory_order_relaxed);
+	}
+	return sum;
+}
+
+uint QueueFragmentStore::getNumberOfUnfinishedFrames() {
+	uint sum = 0;
+	for (uint i = 0; i != numberOfQueues_; i++) {
+		sum += queues_[i].unfinishedFrames.load(std::memory_order_relaxed);
+	}
+	return sum;
+}
+
+uint QueueFragmentStore::getNumberOfDroppedFragments() {
+	uint sum = 0;
+	for (uint i = 0; i != numberOfQueues_; i++) {
+		sum += queues_[i].droppedFragments.load(std::memory_order_relaxed);
+	}
+	return sum;
+}
+
+} /* namespace na62 */
@@ -0,0 +1,151 @@
+/*
+ * QueueFragmentStore.h
+ *
+ * IP fragment reassembly within the PacketHandler threads
+ *
+ *  Created on: Oct 17, 2026
+ */
+
+#ifndef QUEUEFRAGMENTSTORE_H_
+#define QUEUEFRAGMENTSTORE_H_
+
+#include <structs/Network.h>
+#include <sys/types.h>
+#include <atomic>
+#include <cstdint>
+
+#include "BufferPool.h"
+#include "FragmentStore.h"
+
+namespace na62 {
+
+/*
+ * One private fragment table per RX queue. With RSS hashing on the IP addresses all fragments of a
+ * datagram are received on the same queue, so the PacketHandler of that queue can reassemble them
+ * without any synchronization and only complete datagrams are passed to the TaskProcessors.
+ *
+ * The payload of every fragment is copied straight from the RX ring to its final position within a
+ * datagram buffer taken from a per queue BufferPool, so each byte is copied once. The fragments
+ * themselves are never stored.
+ *
+ * Datagrams with fragments on several queues are never completed: use the shared FragmentStore
+ * (reassembleInPacketHandler=0) if the NIC hashes on the UDP ports as well.
+ */
+class QueueFragmentStore {
+public:
+	/**
+	 * Reserves the tables of all queues if reassembleInPacketHandler is set
+	 */
+	static void initialize(uint numberOfQueues);
+
+	/**
+	 * Builds the table of the given queue. Must be called by the PacketHandler of this queue
+	 * after it has been pinned so that the memory is touched first on the local NUMA node
+	 */
+	static void initializeQueue(uint queueNum);
+
+	static inline bool isEnabled() {
+		return queues_ != nullptr;
+	}
+
+	/**
+	 * Copies the payload of the fragment into its datagram. Returns the reassembled frame if this fragment
+	 * completed its datagram and an empty container (data == nullptr) otherwise. The fragment is not
+	 * retained. May only be called by the PacketHandler of <queueNum>
+	 */
+	static DataContainer addFragment(uint queueNum, const char* frame, uint length);
+
+	/**
+	 * Frees the datagrams which became stale since the last call, see FragmentStore::evictStaleFrames().
+	 * May only be called by the PacketHandler of <queueNum>
+	 */
+	static inline void evictStaleFrames(uint queueNum) {
+		Queue& queue = queues_[queueNum];
+		const uint evictionGeneration = FragmentStore::getEvictionGeneration();
+		if (evictionGeneration != queue.evictionGeneration) {
+			queue.evictionGeneration = evictionGeneration;
+			evictSlots(queue, evictionGeneration);
+		}
+	}
+
+	static uint getNumberOfReceivedFragments();
+	static uint getNumberOfReassembledFrames();
+	static uint getNumberOfUnfinishedFrames();
+	static uint getNumberOfDroppedFragments();
+
+private:
+	static const uint MAX_FRAGMENTS = 48;
+	static const uint MAX_PROBES = 16;
+	static const uint64_t FREE = 0;
+
+	static const uint HEADER_BYTES = sizeof(ether_header) + sizeof(iphdr);
+	static const uint MAX_PAYLOAD_BYTES = 0xffff - sizeof(iphdr);
+
+	/*
+	 * Datagram buffers are 64 kB: only the usual number of datagrams in flight is pooled, the rest
+	 * is allocated on the heap
+	 */
+	static const uint POOLED_DATAGRAMS_PER_QUEUE = 32;
+
+	/*
+	 * Payload bytes of one fragment within the datagram
+	 */
+	struct Extent {
+		uint16_t offset;
+		uint16_t length;
+	};
+
+	struct Slot {
+		uint64_t key;
+		uint generation;
+		char* datagram;
+		uint numberOfFragments;
+
+		/*
+		 * 0 until the last fragment arrived
+		 */
+		uint expectedPayloadBytes;
+		uint receivedPayloadBytes;
+		Extent extents[MAX_FRAGMENTS];
+	};
+
+	struct alignas(64) Queue {
+		Slot* slots;
+		uint evictionGeneration;
+
+		/*
+		 * Only written by the PacketHandler of the queue
+		 */
+		std::atomic<uint> fragmentsReceived;
+		std::atomic<uint> reassembledFrames;
+		std::atomic<uint> unfinishedFrames;
+		std::atomic<uint> droppedFragments;
+	};
+
+	static uint numberOfQueues_;
+	static uint slotsPerQueue_;
+	static Queue* queues_;
+	static BufferPool datagramPool_;
+
+	static inline void increment(std::atomic<uint>& counter, int value = 1) {
+		counter.store(counter.load(std::memory_order_relaxed) + value, std::memory_order_relaxed);
+	}
+
+	static Slot* findSlot(Queue& queue, const uint64_t fragID);
+
+	/**
+	 * Frees the datagram buffer if it has not been passed on and marks the slot free
+	 */
+	static void releaseSlot(Queue& queue, Slot* slot);
+
+	static void evictSlots(Queue& queue, const uint evictionGeneration);
+
+	/**
+	 * Returns the datagram of the slot if the fragments cover its payload without gaps or overlaps
+	 */
+	static DataContainer completeFrame(Queue& queue, Slot* slot);
+};
+
+} /* namespace na62 */
+
+#endif /* QUEUEFRAGMENTSTORE_H_ */
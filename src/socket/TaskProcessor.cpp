@@ -7,27 +7,202 @@
 
 #include "TaskProcessor.h"
 #include "HandleFrameTask.h"
+#include "MEPPool.h"
+#include "../eventBuilding/EventDispatcher.h"
+#include "../eventBuilding/L1Builder.h"
+#include "../options/MyOptions.h"
 #include <boost/timer/timer.hpp>
+#include <monitoring/BurstIdHandler.h>
+#include <algorithm>
+#include <sstream>
 
 namespace na62 {
-tbb::concurrent_queue<HandleFrameTask*> TaskProcessor::TasksQueue_;
+std::vector<TaskQueue*> TaskProcessor::TaskQueues_;
+uint TaskProcessor::numberOfHomeGroups_ = 1;
+ThreadOccupancy TaskProcessor::occupancy_;
+uint TaskQueue::creamLaneWeight_ = 0;
 
-TaskProcessor::TaskProcessor(uint task_processor_id):running_(true),task_processor_id_(task_processor_id), dumper_("/var/log/dumped-packets/packets", task_processor_id) {}
+static uint64_t lastLaneWaitMicros[NUMBER_OF_LANES];
+static uint64_t lastLanePoppedTasks[NUMBER_OF_LANES];
+
+TaskProcessor::TaskProcessor(uint task_processor_id):running_(true),task_processor_id_(task_processor_id), creamStreak_(0), dumper_("/var/log/dumped-packets/packets", task_processor_id), l1BatchedEvents_(0) {
+	for (uint queueNum = task_processor_id % numberOfHomeGroups_; queueNum < TaskQueues_.size(); queueNum += numberOfHomeGroups_) {
+		homeQueues_.push_back(queueNum);
+	}
+}
 
 TaskProcessor::~TaskProcessor(){}
 
+void TaskProcessor::initialize(uint numberOfQueues) {
+	TaskQueue::setCreamLaneWeight(Options::GetInt(OPTION_CREAM_LANE_WEIGHT));
+	for (uint i = 0; i != numberOfQueues; i++) {
+		TaskQueue* queue = new TaskQueue();
+		queue->getWaiter().configure(Options::GetInt(OPTION_TP_IDLE_SPINS), Options::GetInt(OPTION_TP_IDLE_YIELDS),
+				Options::GetInt(OPTION_IDLE_PARK_TIMEOUT));
+		TaskQueues_.push_back(queue);
+	}
+	numberOfHomeGroups_ = numberOfQueues;
+}
+
+void TaskProcessor::assignHomeQueues(uint numberOfTaskProcessors) {
+	numberOfHomeGroups_ = std::max(std::min(numberOfTaskProcessors, (uint) TaskQueues_.size()), 1u);
+
+	/*
+	 * Fewer TaskProcessors than queues: the queues of one TaskProcessor wake it up through the waiter of its first queue
+	 */
+	for (uint queueNum = numberOfHomeGroups_; queueNum < TaskQueues_.size(); queueNum++) {
+		TaskQueues_[queueNum]->shareWaiter(*TaskQueues_[queueNum % numberOfHomeGroups_]);
+	}
+}
+
+uint64_t TaskProcessor::getNumberOfParks() {
+	uint64_t sum = 0;
+	for (uint queueNum = 0; queueNum != numberOfHomeGroups_; queueNum++) {
+		sum += TaskQueues_[queueNum]->getWaiter().getNumberOfParks();
+	}
+	return sum;
+}
+
+uint64_t TaskProcessor::getNumberOfWakeups() {
+	uint64_t sum = 0;
+	for (uint queueNum = 0; queueNum != numberOfHomeGroups_; queueNum++) {
+		sum += TaskQueues_[queueNum]->getWaiter().getNumberOfWakeups();
+	}
+	return sum;
+}
+
+int TaskProcessor::getSize() {
+	int sum = 0;
+	for (auto queue : TaskQueues_) {
+		sum += queue->getSize();
+	}
+	return sum;
+}
+
+std::string TaskProcessor::serializeQueueSizes() {
+	std::stringstream stream;
+	for (uint i = 0; i != TaskQueues_.size(); i++) {
+		stream << i << "," << TaskQueues_[i]->getSize() << ";";
+	}
+	return stream.str();
+}
+
+std::string TaskProcessor::serializeStolenTasks() {
+	std::stringstream stream;
+	for (uint i = 0; i != TaskQueues_.size(); i++) {
+		stream << i << "," << TaskQueues_[i]->getNumberOfStolenTasks() << ";";
+	}
+	return stream.str();
+}
+
+std::string TaskProcessor::serializeLaneSizes() {
+	std::stringstream stream;
+	for (uint lane = 0; lane != NUMBER_OF_LANES; lane++) {
+		int size = 0;
+		for (auto queue : TaskQueues_) {
+			size += queue->getSize((TaskLane) lane);
+		}
+		stream << lane << "," << size << ";";
+	}
+	return stream.str();
+}
+
+std::string TaskProcessor::serializeLaneWaitTimes() {
+	/*
+	 * Only called by the monitoring thread
+	 */
+	std::stringstream stream;
+	for (uint lane = 0; lane != NUMBER_OF_LANES; lane++) {
+		uint64_t waitMicros = 0;
+		uint64_t popped = 0;
+		for (auto queue : TaskQueues_) {
+			waitMicros += queue->getWaitMicros((TaskLane) lane);
+			popped += queue->getNumberOfPoppedTasks((TaskLane) lane);
+		}
+		uint64_t tasks = popped - lastLanePoppedTasks[lane];
+		stream << lane << "," << (tasks == 0 ? 0 : (waitMicros - lastLaneWaitMicros[lane]) / tasks) << ";";
+		lastLaneWaitMicros[lane] = waitMicros;
+		lastLanePoppedTasks[lane] = popped;
+	}
+	return stream.str();
+}
+
+bool TaskProcessor::popTask(HandleFrameTask*& task) {
+	for (uint queueNum : homeQueues_) {
+		if (TaskQueues_[queueNum]->tryPop(task, creamStreak_)) {
+			return true;
+		}
+	}
+
+	/*
+	 * Nothing to do for our own PacketHandlers: help the neighbours
+	 */
+	const uint numberOfQueues = TaskQueues_.size();
+	for (uint i = 1; i != numberOfQueues; i++) {
+		const uint queueNum = (homeQueues_.front() + i) % numberOfQueues;
+		if (queueNum % numberOfHomeGroups_ != homeQueues_.front() && TaskQueues_[queueNum]->trySteal(task, creamStreak_)) {
+			return true;
+		}
+	}
+	return false;
+}
+
 void TaskProcessor::thread() {
+		/*
+		 * This thread is already pinned: the pool memory will be local
+		 */
+		HandleFrameTask::initializeVirtualSourcePools(task_processor_id_);
+		MEPPool::initializeTaskProcessor(task_processor_id_);
+
+		IdleWaiter& waiter = TaskQueues_[homeQueues_.front()]->getWaiter();
+		uint unsuccessfulPolls = 0;
 		while (running_) {
+			const tbb::tick_count start = tbb::tick_count::now();
+
+			/*
+			 * Fragments of the events owned by this thread complete events already in the pool: build them first
+			 */
+			bool processed = EventDispatcher::processInbox(this);
+
 			HandleFrameTask* task;
-			if (TaskProcessor::TasksQueue_.try_pop(task)) {
+			if (popTask(task)) {
 				task->execute(this);
-				delete task;
+				task->recycle();
+				processed = true;
+			}
+
+			/*
+			 * Run the L1 trigger over the collected events as soon as the oldest one has waited long enough,
+			 * there is nothing else to do or the burst is being cleaned up
+			 */
+			if (!l1Batch_.empty()
+					&& (!processed || L1Builder::isL1BatchDue(l1Batch_.front()) || BurstIdHandler::flushBurst())) {
+				processL1Batch();
+				processed = true;
+			}
+
+			if (processed) {
+				occupancy_.addBusyTime(task_processor_id_, start);
+				unsuccessfulPolls = 0;
 			} else {
-				boost::this_thread::sleep(boost::posix_time::microsec(50));
+				waiter.idle(unsuccessfulPolls++, [&]() {
+					for (uint queueNum : homeQueues_) {
+						if (!TaskQueues_[queueNum]->empty()) {
+							return true;
+						}
+					}
+					return EventDispatcher::hasInboxWork(this);
+				});
 			}
 		}
+		processL1Batch();
 	}
 
+void TaskProcessor::processL1Batch() {
+	L1Builder::processL1Batch(l1Batch_, strawAlgo_);
+	l1BatchedEvents_.store(0, std::memory_order_release);
+}
+
 void TaskProcessor::dumpPacket(DataContainer container) {
 	dumper_.dumpPacket(container.data, container.length);
 }
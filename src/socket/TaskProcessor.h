@@ -10,15 +10,29 @@
 
 //#include "HandleFrameTask.h"
 #include <utils/AExecutable.h>
-#include <tbb/concurrent_queue.h>
+#include <vector>
+#include <string>
 #include <l1/StrawAlgo.h>
 #include "PcapDump.h"
+#include "TaskQueue.h"
+#include "../utils/ThreadOccupancy.h"
 #include <structs/DataContainer.h>
+#include <tbb/tick_count.h>
 
 namespace na62 {
 
+class Event;
 class HandleFrameTask;
 
+/*
+ * An event completed at L0 waiting for the L1 trigger, see L1Builder::processL1Batch()
+ */
+struct L1BatchEntry {
+	Event* event;
+	tbb::tick_count completionTime;
+	uint_fast8_t l1TriggerTypeWord;
+};
+
 class TaskProcessor: public AExecutable {
 public:
 
@@ -28,19 +42,133 @@ public:
 	StrawAlgo & getStrawAlgo() {
 		return strawAlgo_;
 	}
-	static tbb::concurrent_queue<HandleFrameTask*> TasksQueue_;
-	static int getSize() {
-		return TasksQueue_.unsafe_size();
+	uint getId() const {
+		return task_processor_id_;
+	}
+
+	/**
+	 * Creates one task queue per PacketHandler. Must be called before any PacketHandler or TaskProcessor is created
+	 */
+	static void initialize(uint numberOfQueues);
+
+	/**
+	 * Must be called before the first TaskProcessor is started
+	 */
+	static void initializeOccupancy(uint numberOfTaskProcessors) {
+		occupancy_.initialize(numberOfTaskProcessors);
+	}
+
+	static inline TaskQueue& getQueue(uint queueNum) {
+		return *TaskQueues_[queueNum];
 	}
+
+	static inline uint getNumberOfQueues() {
+		return TaskQueues_.size();
+	}
+
+	/**
+	 * Distributes the queues round robin over the TaskProcessors so that every queue has at least one
+	 * TaskProcessor parking on its waiter. Must be called before any PacketHandler or TaskProcessor is started
+	 */
+	static void assignHomeQueues(uint numberOfTaskProcessors);
+
+	/*
+	 * The first home queue of the TaskProcessor, the one whose waiter it parks on
+	 */
+	static inline TaskQueue& getHomeQueue(uint taskProcessorID) {
+		return *TaskQueues_[taskProcessorID % numberOfHomeGroups_];
+	}
+
+	/*
+	 * Sum of all queue sizes
+	 */
+	static int getSize();
+
+	/*
+	 * Format is "queueNum,value;"
+	 */
+	static std::string serializeQueueSizes();
+	static std::string serializeStolenTasks();
+
+	/*
+	 * Format is "lane,value;" with lane 0: CREAM, 1: L0. The wait times are the average time in
+	 * microseconds the tasks popped since the last call spent in the queues
+	 */
+	static std::string serializeLaneSizes();
+	static std::string serializeLaneWaitTimes();
+
+	/*
+	 * Format is "taskProcessorID,percent;"
+	 */
+	static std::string serializeOccupancy() {
+		return occupancy_.serialize();
+	}
+
+	static uint64_t getNumberOfParks();
+	static uint64_t getNumberOfWakeups();
+
 	void dumpPacket(DataContainer container);
+
+	/**
+	 * Adds an event complete at L0 to the ones waiting for the L1 trigger
+	 *
+	 * @return the number of events waiting
+	 */
+	inline uint addToL1Batch(Event* event) {
+		l1Batch_.push_back(L1BatchEntry { event, tbb::tick_count::now(), 0 });
+		l1BatchedEvents_.store(l1Batch_.size(), std::memory_order_release);
+		return l1Batch_.size();
+	}
+
+	/**
+	 * Runs the L1 trigger over all waiting events. May only be called by this TaskProcessor
+	 */
+	void processL1Batch();
+
+	/*
+	 * May be called by any thread: true while events of this TaskProcessor wait for the L1 trigger
+	 */
+	inline bool hasL1Batch() const {
+		return l1BatchedEvents_.load(std::memory_order_acquire) != 0;
+	}
 private:
 	virtual void thread() override;
 	virtual void onInterruption() override;
+
+	/**
+	 * Pops from the own queues and steals from the other queues if the own ones are empty
+	 */
+	bool popTask(HandleFrameTask*& task);
+
+	static std::vector<TaskQueue*> TaskQueues_;
+
+	/*
+	 * Queue q is a home queue of TaskProcessor t if q and t are equal modulo numberOfHomeGroups_
+	 */
+	static uint numberOfHomeGroups_;
+	static ThreadOccupancy occupancy_;
+
 	std::atomic<bool> running_;
 	uint task_processor_id_;
+	std::vector<uint> homeQueues_;
+
+	/*
+	 * Number of tasks popped from the CREAM lane in a row
+	 */
+	uint creamStreak_;
 	StrawAlgo strawAlgo_;
 	PcapDump dumper_;
 
+	/*
+	 * Only used if l1BatchSize > 1
+	 */
+	std::vector<L1BatchEntry> l1Batch_;
+
+	/*
+	 * Size of l1Batch_ published for hasL1Batch(), only reset once the batch has been processed
+	 */
+	std::atomic<uint> l1BatchedEvents_;
+
 };
 
 }
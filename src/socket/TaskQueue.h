@@ -0,0 +1,172 @@
+/*
+ * TaskQueue.h
+ *
+ * Queue of HandleFrameTasks filled by one single PacketHandler
+ *
+ *  Created on: Oct 17, 2026
+ */
+
+#ifndef TASKQUEUE_H_
+#define TASKQUEUE_H_
+
+#include <atomic>
+#include <cstdint>
+#include <tbb/concurrent_queue.h>
+#include <tbb/tick_count.h>
+
+#include "IdleWaiter.h"
+
+namespace na62 {
+
+class HandleFrameTask;
+
+/*
+ * CREAM data completes events already waiting in the pool for their L1 data, new L0 MEPs
+ * create events. The CREAM lane is therefore served first.
+ */
+enum TaskLane : uint {
+	CREAM_LANE = 0, L0_LANE = 1, NUMBER_OF_LANES = 2
+};
+
+class TaskQueue {
+public:
+	TaskQueue() :
+			queuedFrames_(0), queuedBytes_(0), stolen_(0), waiter_(&ownWaiter_) {
+		for (uint lane = 0; lane != NUMBER_OF_LANES; lane++) {
+			lanes_[lane].waitMicros = 0;
+			lanes_[lane].popped = 0;
+		}
+	}
+
+	/**
+	 * Sets the number of CREAM tasks popped in a row before one L0 task is popped if both lanes are filled
+	 */
+	static void setCreamLaneWeight(uint weight) {
+		creamLaneWeight_ = weight;
+	}
+
+	inline void push(HandleFrameTask* task, TaskLane lane, uint frames, uint bytes) {
+		queuedFrames_.fetch_add(frames, std::memory_order_relaxed);
+		queuedBytes_.fetch_add(bytes, std::memory_order_relaxed);
+		lanes_[lane].tasks.push( { task, tbb::tick_count::now(), frames, bytes });
+		waiter_->notifyOne();
+	}
+
+	/**
+	 * Pop called by one of the TaskProcessors assigned to this queue. <creamStreak> is the number
+	 * of CREAM tasks the calling TaskProcessor has popped in a row
+	 */
+	inline bool tryPop(HandleFrameTask*& task, uint& creamStreak) {
+		if (creamStreak < creamLaneWeight_ && pop(CREAM_LANE, task)) {
+			creamStreak++;
+			return true;
+		}
+		creamStreak = 0;
+		return pop(L0_LANE, task) || pop(CREAM_LANE, task);
+	}
+
+	/**
+	 * Pop called by a TaskProcessor assigned to another queue
+	 */
+	inline bool trySteal(HandleFrameTask*& task, uint& creamStreak) {
+		if (tryPop(task, creamStreak)) {
+			stolen_.fetch_add(1, std::memory_order_relaxed);
+			return true;
+		}
+		return false;
+	}
+
+	inline int getSize() const {
+		return getSize(CREAM_LANE) + getSize(L0_LANE);
+	}
+
+	inline int getSize(TaskLane lane) const {
+		return lanes_[lane].tasks.unsafe_size();
+	}
+
+	inline bool empty() const {
+		return lanes_[CREAM_LANE].tasks.empty() && lanes_[L0_LANE].tasks.empty();
+	}
+
+	/*
+	 * The TaskProcessors assigned to this queue park here when idle
+	 */
+	inline IdleWaiter& getWaiter() {
+		return *waiter_;
+	}
+
+	/**
+	 * Lets this queue wake up the TaskProcessors parked on the waiter of another queue. Must be
+	 * called before the first push
+	 */
+	void shareWaiter(TaskQueue& other) {
+		waiter_ = other.waiter_;
+	}
+
+	/*
+	 * Number of frames and bytes in all tasks waiting in this queue
+	 */
+	inline uint64_t getQueuedFrames() const {
+		return queuedFrames_;
+	}
+
+	inline uint64_t getQueuedBytes() const {
+		return queuedBytes_;
+	}
+
+	inline uint64_t getNumberOfStolenTasks() const {
+		return stolen_;
+	}
+
+	/*
+	 * Sum of the times the tasks popped from <lane> waited in the queue, in microseconds
+	 */
+	inline uint64_t getWaitMicros(TaskLane lane) const {
+		return lanes_[lane].waitMicros;
+	}
+
+	inline uint64_t getNumberOfPoppedTasks(TaskLane lane) const {
+		return lanes_[lane].popped;
+	}
+
+private:
+	struct Entry {
+		HandleFrameTask* task;
+		tbb::tick_count enqueueTime;
+		uint frames;
+		uint bytes;
+	};
+
+	struct Lane {
+		tbb::concurrent_queue<Entry> tasks;
+		std::atomic<uint64_t> waitMicros;
+		std::atomic<uint64_t> popped;
+	};
+
+	inline bool pop(TaskLane lane, HandleFrameTask*& task) {
+		Entry entry;
+		if (!lanes_[lane].tasks.try_pop(entry)) {
+			return false;
+		}
+		task = entry.task;
+		queuedFrames_.fetch_sub(entry.frames, std::memory_order_relaxed);
+		queuedBytes_.fetch_sub(entry.bytes, std::memory_order_relaxed);
+		lanes_[lane].waitMicros.fetch_add((tbb::tick_count::now() - entry.enqueueTime).seconds() * 1E6,
+				std::memory_order_relaxed);
+		lanes_[lane].popped.fetch_add(1, std::memory_order_relaxed);
+		return true;
+	}
+
+	static uint creamLaneWeight_;
+
+	Lane lanes_[NUMBER_OF_LANES];
+	std::atomic<uint64_t> queuedFrames_;
+	std::atomic<uint64_t> queuedBytes_;
+	std::atomic<uint64_t> stolen_;
+	IdleWaiter ownWaiter_;
+	IdleWaiter* waiter_;
+};
+
+} /* namespace na62 */
+
+#endif /* TASKQUEUE_H_ */
@@ -19,6 +19,7 @@
 
 #include "../eventBuilding/StorageHandler.h"
 #include "../options/MyOptions.h"
+#include "../socket/BufferPool.h"
 
 namespace na62 {
 
@@ -76,7 +77,7 @@ void StrawReceiver::processFrame(DataContainer&& data, uint burstID) {
 	 */
 	memcpy(sendData + 8, payload, sendDataLength - 8);
 
-	delete[] data.data;
+	BufferPool::free(data);
 
 	/*
 	 * Prepare ZMQ message
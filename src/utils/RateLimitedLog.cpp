@@ -0,0 +1,184 @@
+/*
+ * RateLimitedLog.cpp
+ *
+ *  Created on: Oct 17, 2026
+ */
+
+#include "RateLimitedLog.h"
+
+#include <algorithm>
+#include <iostream>
+#include <sstream>
+
+#include <options/Logging.h>
+#include <socket/EthernetUtils.h>
+
+#include "../options/MyOptions.h"
+
+namespace na62 {
+
+uint RateLimitedLog::numberOfExemplars_ = 0;
+RateLimitedLog::Category RateLimitedLog::categories_[NUMBER_OF_LOG_CATEGORIES];
+
+namespace {
+
+enum LogLevel {
+	LEVEL_INFO, LEVEL_WARNING, LEVEL_ERROR
+};
+
+enum SourceType {
+	NO_SOURCE, SOURCE_IP, L0_SOURCE_ID, L1_SOURCE_ID
+};
+
+struct CategoryDescription {
+	LogLevel level;
+	SourceType sourceType;
+	const char* message;
+	const char* value1;
+	const char* value2;
+};
+
+/*
+ * Same order as LogCategory
+ */
+const CategoryDescription descriptions[NUMBER_OF_LOG_CATEGORIES] = {
+	{ LEVEL_ERROR, L0_SOURCE_ID, "type = BadEv : Eliminated L0 fragments of events out of the event pool", "event", nullptr },
+	{ LEVEL_ERROR, L1_SOURCE_ID, "type = BadEv : Eliminated L1 fragments of events out of the event pool", "event", nullptr },
+	{ LEVEL_ERROR, SOURCE_IP, "type = BadPack : Received packets with wrong destination IP", "destination", nullptr },
+	{ LEVEL_ERROR, SOURCE_IP, "type = BadPack : check frame failed reason: Received IP-Packets with less bytes than ip.tot_len field", "expected", "received" },
+	{ LEVEL_ERROR, SOURCE_IP, "type = BadPack : check frame failed reason: Received UDP-Packets with less bytes than udp.len field", "expected", "received" },
+	{ LEVEL_WARNING, SOURCE_IP, "Packets with unknown UDP port received", "port", nullptr },
+	{ LEVEL_ERROR, SOURCE_IP, "Empty L1 fragments received", nullptr, nullptr },
+	{ LEVEL_ERROR, SOURCE_IP, "Bad data received", nullptr, nullptr },
+	{ LEVEL_WARNING, NO_SOURCE, "Dropping data because we are at EoB", "run", "burst" },
+	{ LEVEL_INFO, SOURCE_IP, "Fragmented packets received", "IP id", nullptr },
+	{ LEVEL_INFO, SOURCE_IP, "Fragmented packets reassembled", "IP id", "bytes" },
+	{ LEVEL_ERROR, SOURCE_IP, "Fragmented packets dropped", "IP id", nullptr },
+	{ LEVEL_WARNING, SOURCE_IP, "Incomplete fragmented packets evicted", "IP id", "fragments" }
+};
+
+void write(LogLevel level, const std::string& message) {
+	switch (level) {
+	case LEVEL_INFO:
+		LOG_INFO(message);
+		break;
+	case LEVEL_WARNING:
+		LOG_WARNING(message);
+		break;
+	case LEVEL_ERROR:
+		LOG_ERROR(message);
+		break;
+	}
+}
+
+} /* namespace */
+
+void RateLimitedLog::initialize() {
+	numberOfExemplars_ = std::min((uint) Options::GetInt(OPTION_LOG_EXEMPLARS), MAX_EXEMPLARS);
+
+	for (Category& category : categories_) {
+		category.otherSources = 0;
+		for (SourceCount& source : category.sources) {
+			source.source = 0;
+			source.count = 0;
+		}
+		for (Exemplar& exemplar : category.exemplars) {
+			exemplar.state = EXEMPLAR_FREE;
+		}
+		category.exemplarsTaken = 0;
+	}
+}
+
+void RateLimitedLog::printSource(std::ostream& stream, LogCategory category, uint32_t source) {
+	if (source == ~0u) {
+		source = 0;
+	}
+
+	switch (descriptions[category].sourceType) {
+	case NO_SOURCE:
+		break;
+	case SOURCE_IP:
+		stream << " from " << EthernetUtils::ipToString(source);
+		break;
+	case L0_SOURCE_ID:
+		stream << " from source 0x" << std::hex << (source >> 16) << ":" << (source & 0xffff) << std::dec;
+		break;
+	case L1_SOURCE_ID:
+		stream << " from source 0x" << std::hex << (source >> 16) << ":0x" << (source & 0xffff) << std::dec << " -- "
+				<< ((source >> 5) & 0x3f) << "--" << (source & 0x1f);
+		break;
+	}
+}
+
+void RateLimitedLog::printExemplar(std::ostream& stream, LogCategory category, const Exemplar& exemplar) {
+	const CategoryDescription& description = descriptions[category];
+
+	stream << "    e.g.";
+	printSource(stream, category, exemplar.source);
+	if (description.value1 != nullptr) {
+		stream << " " << description.value1 << " ";
+		if (category == WRONG_DESTINATION_IP) {
+			stream << EthernetUtils::ipToString(exemplar.value1);
+		} else {
+			stream << exemplar.value1;
+		}
+	}
+	if (description.value2 != nullptr) {
+		stream << " " << description.value2 << " " << exemplar.value2;
+	}
+	if (exemplar.text[0] != 0) {
+		stream << ": " << exemplar.text;
+	}
+}
+
+void RateLimitedLog::flush() {
+	for (uint categoryNum = 0; categoryNum != NUMBER_OF_LOG_CATEGORIES; categoryNum++) {
+		const LogCategory category = (LogCategory) categoryNum;
+		Category& c = categories_[category];
+
+		std::stringstream stream;
+		uint64_t total = 0;
+
+		for (SourceCount& source : c.sources) {
+			if (source.source.load(std::memory_order_relaxed) == 0) {
+				continue;
+			}
+			const uint64_t count = source.count.exchange(0, std::memory_order_relaxed);
+			if (count == 0) {
+				continue;
+			}
+			total += count;
+			stream << "\n    " << count << " times";
+			printSource(stream, category, source.source.load(std::memory_order_relaxed));
+		}
+
+		const uint64_t others = c.otherSources.exchange(0, std::memory_order_relaxed);
+		if (others != 0) {
+			total += others;
+			stream << "\n    " << others << " times from other sources";
+		}
+
+		if (total == 0) {
+			continue;
+		}
+
+		/*
+		 * Slots still being written are skipped and stay claimed until they are ready, so the
+		 * reports of the next interval can't write into them
+		 */
+		for (uint i = 0; i != numberOfExemplars_; i++) {
+			Exemplar& exemplar = c.exemplars[i];
+			if (exemplar.state.load(std::memory_order_acquire) == EXEMPLAR_READY) {
+				stream << "\n";
+				printExemplar(stream, category, exemplar);
+				exemplar.state.store(EXEMPLAR_FREE, std::memory_order_release);
+			}
+		}
+		c.exemplarsTaken.store(0, std::memory_order_relaxed);
+
+		write(descriptions[category].level, std::string(descriptions[category].message) + ": " + std::to_string(total)
+				+ " times since the last report" + stream.str());
+	}
+}
+
+} /* namespace na62 */
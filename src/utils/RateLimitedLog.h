@@ -0,0 +1,149 @@
+/*
+ * RateLimitedLog.h
+ *
+ * Aggregated logging of error conditions which may occur once per frame or event
+ *
+ *  Created on: Oct 17, 2026
+ */
+
+#ifndef RATELIMITEDLOG_H_
+#define RATELIMITEDLOG_H_
+
+#include <sys/types.h>
+#include <atomic>
+#include <cstdint>
+#include <cstring>
+#include <iosfwd>
+
+namespace na62 {
+
+enum LogCategory : uint {
+	L0_FRAGMENT_DROPPED,
+	L1_FRAGMENT_DROPPED,
+	WRONG_DESTINATION_IP,
+	BAD_IP_LENGTH,
+	BAD_UDP_LENGTH,
+	UNKNOWN_UDP_PORT,
+	EMPTY_L1_MEP,
+	BAD_DATA,
+	EOB_FRAME_DROPPED,
+	IP_FRAGMENT_RECEIVED,
+	IP_FRAME_REASSEMBLED,
+	BAD_IP_FRAGMENTS,
+	STALE_IP_FRAGMENTS,
+	NUMBER_OF_LOG_CATEGORIES
+};
+
+/*
+ * The worker threads only count the reports per category and source and copy the raw values of the
+ * first few reports of every interval. flush(), called by the MonitorConnector, formats and writes one
+ * summary line per category and source plus the exemplars and starts the next interval.
+ */
+class RateLimitedLog {
+public:
+	static void initialize();
+
+	/**
+	 * <source> is an IP or (sourceID << 16 | sourceSubID) depending on the category.
+	 * <text> is only copied for exemplars and may be nullptr
+	 */
+	static inline void report(LogCategory category, uint32_t source, uint32_t value1 = 0, uint32_t value2 = 0,
+			const char* text = nullptr) {
+		count(category, source);
+
+		Category& c = categories_[category];
+		if (c.exemplarsTaken.load(std::memory_order_relaxed) >= numberOfExemplars_) {
+			return;
+		}
+		const uint index = c.exemplarsTaken.fetch_add(1, std::memory_order_relaxed);
+		if (index >= numberOfExemplars_) {
+			return;
+		}
+		/*
+		 * The slot may still be written by a report of the previous interval
+		 */
+		Exemplar& exemplar = c.exemplars[index];
+		uint8_t state = EXEMPLAR_FREE;
+		if (!exemplar.state.compare_exchange_strong(state, EXEMPLAR_WRITING, std::memory_order_acquire)) {
+			return;
+		}
+		exemplar.source = source;
+		exemplar.value1 = value1;
+		exemplar.value2 = value2;
+		if (text != nullptr) {
+			strncpy(exemplar.text, text, sizeof(exemplar.text) - 1);
+			exemplar.text[sizeof(exemplar.text) - 1] = 0;
+		} else {
+			exemplar.text[0] = 0;
+		}
+		exemplar.state.store(EXEMPLAR_READY, std::memory_order_release);
+	}
+
+	/**
+	 * Writes everything reported since the last call
+	 */
+	static void flush();
+
+private:
+	static const uint MAX_EXEMPLARS = 8;
+	static const uint SOURCE_SLOTS = 64;
+
+	enum ExemplarState : uint8_t {
+		EXEMPLAR_FREE, EXEMPLAR_WRITING, EXEMPLAR_READY
+	};
+
+	struct Exemplar {
+		std::atomic<uint8_t> state;
+		uint32_t source;
+		uint32_t value1;
+		uint32_t value2;
+		char text[96];
+	};
+
+	struct SourceCount {
+		std::atomic<uint32_t> source;
+		std::atomic<uint64_t> count;
+	};
+
+	struct alignas(64) Category {
+		/*
+		 * Reports of sources not fitting into the table are counted here
+		 */
+		std::atomic<uint64_t> otherSources;
+		SourceCount sources[SOURCE_SLOTS];
+
+		std::atomic<uint> exemplarsTaken;
+		Exemplar exemplars[MAX_EXEMPLARS];
+	};
+
+	static inline void count(LogCategory category, uint32_t source) {
+		Category& c = categories_[category];
+
+		/*
+		 * Source 0 marks a free slot, so it's stored as ~0
+		 */
+		const uint32_t key = source == 0 ? ~0u : source;
+		uint slot = (key * 2654435761u) % SOURCE_SLOTS;
+		for (uint probe = 0; probe != SOURCE_SLOTS; probe++, slot = (slot + 1) % SOURCE_SLOTS) {
+			uint32_t current = c.sources[slot].source.load(std::memory_order_relaxed);
+			if (current == 0 && c.sources[slot].source.compare_exchange_strong(current, key, std::memory_order_relaxed)) {
+				current = key;
+			}
+			if (current == key) {
+				c.sources[slot].count.fetch_add(1, std::memory_order_relaxed);
+				return;
+			}
+		}
+		c.otherSources.fetch_add(1, std::memory_order_relaxed);
+	}
+
+	static void printSource(std::ostream& stream, LogCategory category, uint32_t source);
+	static void printExemplar(std::ostream& stream, LogCategory category, const Exemplar& exemplar);
+
+	static uint numberOfExemplars_;
+	static Category categories_[NUMBER_OF_LOG_CATEGORIES];
+};
+
+} /* namespace na62 */
+
+#endif /* RATELIMITEDLOG_H_ */
@@ -0,0 +1,93 @@
+/*
+ * ShardedCounters.cpp
+ *
+ *  Created on: Oct 17, 2026
+ */
+
+#include "ShardedCounters.h"
+
+#include <cstdlib>
+#include <new>
+
+namespace na62 {
+
+std::atomic<uint> ShardedCounters::nextShard_(0);
+
+static const size_t CACHE_LINE_SIZE = 64;
+
+ShardedCounters::ShardedCounters(uint numberOfCounters) :
+		numberOfCounters_(0), overflow_(nullptr), baselines_(nullptr) {
+	for (auto& shard : shards_) {
+		shard = nullptr;
+	}
+	if (numberOfCounters != 0) {
+		initialize(numberOfCounters);
+	}
+}
+
+ShardedCounters::~ShardedCounters() {
+	for (auto& shard : shards_) {
+		free(shard.load());
+	}
+	delete[] overflow_;
+	delete[] baselines_;
+}
+
+void ShardedCounters::initialize(uint numberOfCounters) {
+	numberOfCounters_ = numberOfCounters;
+	overflow_ = new std::atomic<uint64_t>[numberOfCounters];
+	baselines_ = new std::atomic<uint64_t>[numberOfCounters];
+	for (uint i = 0; i != numberOfCounters; i++) {
+		overflow_[i] = 0;
+		baselines_[i] = 0;
+	}
+}
+
+std::atomic<uint64_t>* ShardedCounters::allocateShard(uint shard) {
+	/*
+	 * Rounded up to full cache lines so that no two shards share one
+	 */
+	const size_t bytes = (numberOfCounters_ * sizeof(std::atomic<uint64_t>) + CACHE_LINE_SIZE - 1) / CACHE_LINE_SIZE
+			* CACHE_LINE_SIZE;
+
+	void* memory;
+	if (posix_memalign(&memory, CACHE_LINE_SIZE, bytes) != 0) {
+		throw std::bad_alloc();
+	}
+
+	std::atomic<uint64_t>* counters = reinterpret_cast<std::atomic<uint64_t>*>(memory);
+	for (uint i = 0; i != numberOfCounters_; i++) {
+		new (&counters[i]) std::atomic<uint64_t>(0);
+	}
+	shards_[shard].store(counters, std::memory_order_release);
+	return counters;
+}
+
+uint64_t ShardedCounters::getSum(uint counter) const {
+	uint64_t sum = overflow_[counter].load(std::memory_order_relaxed);
+	for (auto& shard : shards_) {
+		const std::atomic<uint64_t>* counters = shard.load(std::memory_order_acquire);
+		if (counters != nullptr) {
+			sum += counters[counter].load(std::memory_order_relaxed);
+		}
+	}
+	return sum;
+}
+
+uint64_t ShardedCounters::get(uint counter) const {
+	const uint64_t baseline = baselines_[counter].load(std::memory_order_relaxed);
+	const uint64_t sum = getSum(counter);
+	return sum > baseline ? sum - baseline : 0;
+}
+
+void ShardedCounters::reset(uint counter) {
+	baselines_[counter].store(getSum(counter), std::memory_order_relaxed);
+}
+
+void ShardedCounters::reset() {
+	for (uint i = 0; i != numberOfCounters_; i++) {
+		reset(i);
+	}
+}
+
+} /* namespace na62 */
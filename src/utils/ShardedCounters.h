@@ -0,0 +1,90 @@
+/*
+ * ShardedCounters.h
+ *
+ * Statistics counters incremented without atomic read-modify-write operations
+ *
+ *  Created on: Oct 17, 2026
+ */
+
+#ifndef SHARDEDCOUNTERS_H_
+#define SHARDEDCOUNTERS_H_
+
+#include <sys/types.h>
+#include <atomic>
+#include <cstdint>
+
+namespace na62 {
+
+/*
+ * A set of counters with one shard per incrementing thread. A shard holds all counters of the set,
+ * starts at a cache line boundary and is only written by its thread so that add() is a plain load
+ * and store. The shard is allocated by its thread at the first add() to be local to its NUMA node.
+ *
+ * get() sums up all shards. reset() does not touch the shards but stores the current sums as
+ * baseline subtracted by get(). Concurrent increments are therefore never lost by a reset.
+ */
+class ShardedCounters {
+public:
+	explicit ShardedCounters(uint numberOfCounters = 0);
+	~ShardedCounters();
+
+	/**
+	 * Must be called before the first add() if the number of counters was not known at construction
+	 */
+	void initialize(uint numberOfCounters);
+
+	inline void add(uint counter, uint64_t value) {
+		const uint shard = getThreadShard();
+		if (shard < MAX_SHARDS) {
+			std::atomic<uint64_t>* counters = shards_[shard].load(std::memory_order_relaxed);
+			if (counters == nullptr) {
+				counters = allocateShard(shard);
+			}
+			counters[counter].store(counters[counter].load(std::memory_order_relaxed) + value, std::memory_order_relaxed);
+		} else {
+			overflow_[counter].fetch_add(value, std::memory_order_relaxed);
+		}
+	}
+
+	inline void increment(uint counter) {
+		add(counter, 1);
+	}
+
+	/**
+	 * Sum of all shards since the last reset of <counter>
+	 */
+	uint64_t get(uint counter) const;
+
+	void reset(uint counter);
+	void reset();
+
+	inline uint getNumberOfCounters() const {
+		return numberOfCounters_;
+	}
+
+private:
+	static const uint MAX_SHARDS = 128;
+
+	/*
+	 * Threads beyond MAX_SHARDS share the atomic overflow_ counters
+	 */
+	static inline uint getThreadShard() {
+		static thread_local uint shard = nextShard_.fetch_add(1, std::memory_order_relaxed);
+		return shard;
+	}
+
+	std::atomic<uint64_t>* allocateShard(uint shard);
+
+	uint64_t getSum(uint counter) const;
+
+	uint numberOfCounters_;
+	std::atomic<std::atomic<uint64_t>*> shards_[MAX_SHARDS];
+	std::atomic<uint64_t>* overflow_;
+	std::atomic<uint64_t>* baselines_;
+
+	static std::atomic<uint> nextShard_;
+};
+
+} /* namespace na62 */
+
+#endif /* SHARDEDCOUNTERS_H_ */
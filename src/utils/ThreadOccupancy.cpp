@@ -0,0 +1,45 @@
+/*
+ * ThreadOccupancy.cpp
+ *
+ *  Created on: Oct 18, 2026
+ */
+
+#include "ThreadOccupancy.h"
+
+#include <algorithm>
+#include <cstdlib>
+#include <new>
+#include <sstream>
+
+namespace na62 {
+
+void ThreadOccupancy::initialize(uint numberOfThreads) {
+	numberOfThreads_ = numberOfThreads;
+	void* memory;
+	if (posix_memalign(&memory, 64, numberOfThreads * sizeof(Thread)) != 0) {
+		throw std::bad_alloc();
+	}
+	threads_ = reinterpret_cast<Thread*>(memory);
+	for (uint i = 0; i != numberOfThreads; i++) {
+		new (&threads_[i].busyMicros) std::atomic<uint64_t>(0);
+		threads_[i].lastBusyMicros = 0;
+	}
+	lastCall_ = tbb::tick_count::now();
+}
+
+std::string ThreadOccupancy::serialize() {
+	const tbb::tick_count now = tbb::tick_count::now();
+	const double elapsedMicros = (now - lastCall_).seconds() * 1E6;
+	lastCall_ = now;
+
+	std::stringstream stream;
+	for (uint i = 0; i != numberOfThreads_; i++) {
+		const uint64_t busyMicros = threads_[i].busyMicros.load(std::memory_order_relaxed);
+		const uint64_t percent = elapsedMicros == 0 ? 0 : (busyMicros - threads_[i].lastBusyMicros) * 100 / elapsedMicros;
+		threads_[i].lastBusyMicros = busyMicros;
+		stream << i << "," << std::min(percent, (uint64_t) 100) << ";";
+	}
+	return stream.str();
+}
+
+} /* namespace na62 */
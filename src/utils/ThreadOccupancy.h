@@ -0,0 +1,62 @@
+/*
+ * ThreadOccupancy.h
+ *
+ * Fraction of the time the threads of a pool spend working
+ *
+ *  Created on: Oct 18, 2026
+ */
+
+#ifndef THREADOCCUPANCY_H_
+#define THREADOCCUPANCY_H_
+
+#include <sys/types.h>
+#include <atomic>
+#include <cstdint>
+#include <string>
+#include <tbb/tick_count.h>
+
+namespace na62 {
+
+/*
+ * Every thread of the pool adds the time it spent on work to its own counter. The monitoring
+ * thread turns the counters into the occupancy since its last call.
+ */
+class ThreadOccupancy {
+public:
+	ThreadOccupancy() :
+			numberOfThreads_(0), threads_(nullptr), lastCall_(tbb::tick_count::now()) {
+	}
+
+	/**
+	 * Must be called before the first thread of the pool is started
+	 */
+	void initialize(uint numberOfThreads);
+
+	/**
+	 * Adds the time since <start> to the busy time of the given thread. May only be called by this thread
+	 */
+	inline void addBusyTime(uint threadNum, const tbb::tick_count& start) {
+		std::atomic<uint64_t>& busyMicros = threads_[threadNum].busyMicros;
+		const uint64_t micros = (tbb::tick_count::now() - start).seconds() * 1E6;
+		busyMicros.store(busyMicros.load(std::memory_order_relaxed) + micros, std::memory_order_relaxed);
+	}
+
+	/*
+	 * Format is "threadNum,percent;" with the occupancy since the last call. Only called by the monitoring thread
+	 */
+	std::string serialize();
+
+private:
+	struct alignas(64) Thread {
+		std::atomic<uint64_t> busyMicros;
+		uint64_t lastBusyMicros;
+	};
+
+	uint numberOfThreads_;
+	Thread* threads_;
+	tbb::tick_count lastCall_;
+};
+
+} /* namespace na62 */
+
+#endif /* THREADOCCUPANCY_H_ */
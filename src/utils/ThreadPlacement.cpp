@@ -0,0 +1,289 @@
+/*
+ * ThreadPlacement.cpp
+ *
+ *  Created on: Oct 17, 2026
+ */
+
+#include "ThreadPlacement.h"
+
+#include <pthread.h>
+#include <sched.h>
+#include <algorithm>
+#include <fstream>
+#include <sstream>
+#include <thread>
+
+#include <options/Logging.h>
+
+namespace na62 {
+
+std::vector<ThreadPlacement::CPU> ThreadPlacement::cpus_;
+std::vector<int> ThreadPlacement::nodes_;
+std::string ThreadPlacement::deviceName_;
+int ThreadPlacement::nicNode_ = 0;
+
+std::vector<int> ThreadPlacement::housekeepingCPUs_;
+std::vector<int> ThreadPlacement::packetHandlerCPUs_;
+std::vector<int> ThreadPlacement::taskProcessorCPUs_;
+std::vector<int> ThreadPlacement::l1ProcessorCPUs_;
+
+static const std::string CPU_PATH = "/sys/devices/system/cpu/";
+static const std::string NODE_PATH = "/sys/devices/system/node/";
+
+void ThreadPlacement::initialize(std::string deviceName, uint numberOfHousekeepingCores) {
+	/*
+	 * pf_ring device names may look like zc:eth2@0
+	 */
+	if (deviceName.find(':') != std::string::npos) {
+		deviceName = deviceName.substr(deviceName.find(':') + 1);
+	}
+	deviceName_ = deviceName.substr(0, deviceName.find('@'));
+
+	std::vector<int> online = parseCPUList(readLine(CPU_PATH + "online"));
+	if (online.empty()) {
+		LOG_WARNING("Unable to read the CPU topology: assuming " << std::thread::hardware_concurrency() << " independent cores");
+		for (uint cpu = 0; cpu != std::thread::hardware_concurrency(); cpu++) {
+			online.push_back(cpu);
+		}
+	}
+
+	for (int id : online) {
+		std::string topology = CPU_PATH + "cpu" + std::to_string(id) + "/topology/";
+		CPU cpu;
+		cpu.id = id;
+		cpu.node = 0;
+		cpu.package = readInt(topology + "physical_package_id", 0);
+		cpu.core = readInt(topology + "core_id", id);
+		std::vector<int> siblings = parseCPUList(readLine(topology + "thread_siblings_list"));
+		cpu.primaryThread = siblings.empty() || siblings.front() == id;
+		cpus_.push_back(cpu);
+	}
+
+	for (int node = 0;; node++) {
+		std::string cpuList = readLine(NODE_PATH + "node" + std::to_string(node) + "/cpulist");
+		if (cpuList.empty() && node != 0) {
+			break;
+		}
+		nodes_.push_back(node);
+		for (int id : parseCPUList(cpuList)) {
+			for (CPU& cpu : cpus_) {
+				if (cpu.id == id) {
+					cpu.node = node;
+				}
+			}
+		}
+	}
+
+	nicNode_ = readInt("/sys/class/net/" + deviceName_ + "/device/numa_node", -1);
+	if (std::find(nodes_.begin(), nodes_.end(), nicNode_) == nodes_.end()) {
+		nicNode_ = cpus_.front().node;
+	}
+	std::stable_partition(nodes_.begin(), nodes_.end(), [](int node) {return node == nicNode_;});
+
+	/*
+	 * Housekeeping cores are taken from the end of the node farthest away from the NIC
+	 */
+	for (auto node = nodes_.rbegin(); node != nodes_.rend(); ++node) {
+		for (auto cpu = cpus_.rbegin(); cpu != cpus_.rend(); ++cpu) {
+			if (housekeepingCPUs_.size() >= numberOfHousekeepingCores) {
+				break;
+			}
+			if (cpu->node == *node && cpu->primaryThread && !isUsed(cpu->id)) {
+				housekeepingCPUs_.push_back(cpu->id);
+			}
+		}
+	}
+
+	/*
+	 * Never reserve all CPUs
+	 */
+	if (housekeepingCPUs_.size() >= (size_t) std::count_if(cpus_.begin(), cpus_.end(), [](const CPU& cpu) {return cpu.primaryThread;})) {
+		housekeepingCPUs_.clear();
+	}
+
+	std::vector<int> housekeepingSiblings;
+	for (const CPU& cpu : cpus_) {
+		if (!cpu.primaryThread && isSiblingOf(cpu, housekeepingCPUs_)) {
+			housekeepingSiblings.push_back(cpu.id);
+		}
+	}
+	housekeepingCPUs_.insert(housekeepingCPUs_.end(), housekeepingSiblings.begin(), housekeepingSiblings.end());
+	std::sort(housekeepingCPUs_.begin(), housekeepingCPUs_.end());
+}
+
+void ThreadPlacement::pinToHousekeeping() {
+	if (housekeepingCPUs_.empty()) {
+		return;
+	}
+
+	cpu_set_t cpuSet;
+	CPU_ZERO(&cpuSet);
+	for (int cpu : housekeepingCPUs_) {
+		CPU_SET(cpu, &cpuSet);
+	}
+	if (pthread_setaffinity_np(pthread_self(), sizeof(cpu_set_t), &cpuSet) != 0) {
+		LOG_WARNING("Unable to pin the service threads to CPUs " << toCPUList(housekeepingCPUs_));
+	}
+}
+
+void ThreadPlacement::placeWorkers(uint numberOfPacketHandlers, uint numberOfL1Processors) {
+	packetHandlerCPUs_.clear();
+	taskProcessorCPUs_.clear();
+	l1ProcessorCPUs_.clear();
+
+	/*
+	 * One physical core per PacketHandler, NIC local node first
+	 */
+	for (int node : nodes_) {
+		for (const CPU& cpu : cpus_) {
+			if (packetHandlerCPUs_.size() == numberOfPacketHandlers) {
+				break;
+			}
+			if (cpu.node == node && cpu.primaryThread && !isUsed(cpu.id)) {
+				packetHandlerCPUs_.push_back(cpu.id);
+			}
+		}
+	}
+
+	/*
+	 * More PacketHandlers than free cores: share hyperthreads, then CPUs
+	 */
+	for (uint i = 0; packetHandlerCPUs_.size() < numberOfPacketHandlers; i++) {
+		packetHandlerCPUs_.push_back(cpus_[i % cpus_.size()].id);
+	}
+
+	/*
+	 * TaskProcessors on the remaining CPUs, NIC local node first. The hyperthreads of the
+	 * PacketHandler cores are used last as they compete with the polling threads.
+	 */
+	std::vector<int> packetHandlerSiblings;
+	for (int node : nodes_) {
+		for (const CPU& cpu : cpus_) {
+			if (cpu.node != node || isUsed(cpu.id)) {
+				continue;
+			}
+			if (isSiblingOf(cpu, packetHandlerCPUs_)) {
+				packetHandlerSiblings.push_back(cpu.id);
+			} else {
+				taskProcessorCPUs_.push_back(cpu.id);
+			}
+		}
+	}
+
+	/*
+	 * The L1Processors get the CPUs of the TaskProcessors farthest away from the NIC, but no hyperthreads
+	 * of PacketHandler cores and never the last TaskProcessor CPU
+	 */
+	while (l1ProcessorCPUs_.size() != numberOfL1Processors && taskProcessorCPUs_.size() + packetHandlerSiblings.size() > 1
+			&& !taskProcessorCPUs_.empty()) {
+		l1ProcessorCPUs_.insert(l1ProcessorCPUs_.begin(), taskProcessorCPUs_.back());
+		taskProcessorCPUs_.pop_back();
+	}
+	taskProcessorCPUs_.insert(taskProcessorCPUs_.end(), packetHandlerSiblings.begin(), packetHandlerSiblings.end());
+
+	if (taskProcessorCPUs_.empty()) {
+		for (const CPU& cpu : cpus_) {
+			taskProcessorCPUs_.push_back(cpu.id);
+		}
+	}
+
+	/*
+	 * More L1Processors than free CPUs: share them with the TaskProcessors
+	 */
+	for (uint i = 0; l1ProcessorCPUs_.size() < numberOfL1Processors; i++) {
+		l1ProcessorCPUs_.push_back(taskProcessorCPUs_[i % taskProcessorCPUs_.size()]);
+	}
+}
+
+void ThreadPlacement::printPlacement() {
+	LOG_INFO("Thread placement: " << cpus_.size() << " CPUs on " << nodes_.size() << " NUMA nodes, " << deviceName_ << " on node " << nicNode_);
+	for (uint i = 0; i != packetHandlerCPUs_.size(); i++) {
+		int node = 0;
+		for (const CPU& cpu : cpus_) {
+			if (cpu.id == packetHandlerCPUs_[i]) {
+				node = cpu.node;
+			}
+		}
+		LOG_INFO("Thread placement: PacketHandler " << i << " on CPU " << packetHandlerCPUs_[i] << " (node " << node << ")");
+	}
+	LOG_INFO("Thread placement: " << taskProcessorCPUs_.size() << " TaskProcessors on CPUs " << toCPUList(taskProcessorCPUs_));
+	if (!l1ProcessorCPUs_.empty()) {
+		LOG_INFO("Thread placement: " << l1ProcessorCPUs_.size() << " L1Processors on CPUs " << toCPUList(l1ProcessorCPUs_));
+	}
+	LOG_INFO("Thread placement: service threads on CPUs " << (housekeepingCPUs_.empty() ? "any" : toCPUList(housekeepingCPUs_)));
+}
+
+bool ThreadPlacement::isUsed(int cpu) {
+	return std::find(housekeepingCPUs_.begin(), housekeepingCPUs_.end(), cpu) != housekeepingCPUs_.end()
+			|| std::find(packetHandlerCPUs_.begin(), packetHandlerCPUs_.end(), cpu) != packetHandlerCPUs_.end();
+}
+
+bool ThreadPlacement::isSiblingOf(const CPU& cpu, const std::vector<int>& others) {
+	for (const CPU& other : cpus_) {
+		if (other.id != cpu.id && other.package == cpu.package && other.core == cpu.core
+				&& std::find(others.begin(), others.end(), other.id) != others.end()) {
+			return true;
+		}
+	}
+	return false;
+}
+
+std::vector<int> ThreadPlacement::parseCPUList(std::string list) {
+	std::vector<int> cpus;
+	std::stringstream stream(list);
+	std::string range;
+	while (std::getline(stream, range, ',')) {
+		if (range.empty()) {
+			continue;
+		}
+		try {
+			size_t dash = range.find('-');
+			int first = std::stoi(range.substr(0, dash));
+			int last = dash == std::string::npos ? first : std::stoi(range.substr(dash + 1));
+			for (int cpu = first; cpu <= last; cpu++) {
+				cpus.push_back(cpu);
+			}
+		} catch (const std::exception&) {
+			LOG_WARNING("Unable to parse CPU list " << list);
+			return std::vector<int>();
+		}
+	}
+	return cpus;
+}
+
+std::string ThreadPlacement::toCPUList(const std::vector<int>& cpus) {
+	std::stringstream list;
+	for (uint i = 0; i != cpus.size(); i++) {
+		uint last = i;
+		while (last + 1 != cpus.size() && cpus[last + 1] == cpus[last] + 1) {
+			last++;
+		}
+		if (i != 0) {
+			list << ",";
+		}
+		list << cpus[i];
+		if (last != i) {
+			list << "-" << cpus[last];
+		}
+		i = last;
+	}
+	return list.str();
+}
+
+int ThreadPlacement::readInt(std::string fileName, int defaultValue) {
+	std::string line = readLine(fileName);
+	try {
+		return line.empty() ? defaultValue : std::stoi(line);
+	} catch (const std::exception&) {
+		return defaultValue;
+	}
+}
+
+std::string ThreadPlacement::readLine(std::string fileName) {
+	std::ifstream file(fileName);
+	std::string line;
+	std::getline(file, line);
+	return line;
+}
+
+} /* namespace na62 */
@@ -0,0 +1,88 @@
+/*
+ * ThreadPlacement.h
+ *
+ * Decides on which CPUs the farm threads run, based on the CPU topology and
+ * the NUMA node of the receiving NIC as found in /sys
+ *
+ *  Created on: Oct 17, 2026
+ */
+
+#ifndef THREADPLACEMENT_H_
+#define THREADPLACEMENT_H_
+
+#include <sys/types.h>
+#include <string>
+#include <vector>
+
+namespace na62 {
+
+class ThreadPlacement {
+public:
+	/**
+	 * Reads the topology and reserves <numberOfHousekeepingCores> physical cores, as far away from the NIC
+	 * as possible, for the service threads (StorageHandler, BurstIdHandler, L1DistributionHandler, ZMQ IO...)
+	 */
+	static void initialize(std::string deviceName, uint numberOfHousekeepingCores);
+
+	/**
+	 * Pins the calling thread to the housekeeping CPUs. All threads started afterwards without explicit
+	 * CPU inherit this affinity
+	 */
+	static void pinToHousekeeping();
+
+	/**
+	 * Places one PacketHandler per physical core of the NIC local node and the TaskProcessors on
+	 * the remaining CPUs, closest to the NIC first. The L1Processors take the CPUs farthest away
+	 * from the NIC
+	 */
+	static void placeWorkers(uint numberOfPacketHandlers, uint numberOfL1Processors);
+
+	static inline int getPacketHandlerCPU(uint threadNum) {
+		return packetHandlerCPUs_[threadNum];
+	}
+
+	static inline const std::vector<int>& getTaskProcessorCPUs() {
+		return taskProcessorCPUs_;
+	}
+
+	static inline const std::vector<int>& getL1ProcessorCPUs() {
+		return l1ProcessorCPUs_;
+	}
+
+	static void printPlacement();
+
+private:
+	struct CPU {
+		int id;
+		int node;
+		int package;
+		int core;
+		bool primaryThread;
+	};
+
+	static std::vector<int> parseCPUList(std::string list);
+	static std::string toCPUList(const std::vector<int>& cpus);
+	static int readInt(std::string fileName, int defaultValue);
+	static std::string readLine(std::string fileName);
+
+	static bool isUsed(int cpu);
+	static bool isSiblingOf(const CPU& cpu, const std::vector<int>& others);
+
+	static std::vector<CPU> cpus_;
+
+	/*
+	 * NUMA nodes ordered by their distance to the NIC, the NIC node first
+	 */
+	static std::vector<int> nodes_;
+	static std::string deviceName_;
+	static int nicNode_;
+
+	static std::vector<int> housekeepingCPUs_;
+	static std::vector<int> packetHandlerCPUs_;
+	static std::vector<int> taskProcessorCPUs_;
+	static std::vector<int> l1ProcessorCPUs_;
+};
+
+} /* namespace na62 */
+
+#endif /* THREADPLACEMENT_H_ */